@@ -0,0 +1,326 @@
+// ImageProcessor microbenchmarks
+//
+// Measures kernel throughput natively: megapixels per second for every
+// resize filter and every encoder at several quality levels, over source
+// sizes from 64x64 to 8K, plus WebP decode (full and scaled), SSIM-targeted
+// encoding, content analysis, MS-SSIM, srcset variant generation and raw
+// rANS coder throughput in MB/s. Results go to stdout (or --out) as one JSON
+// document so CI can diff them per commit.
+//
+//   image-processor-bench [--max-size N] [--min-time S] [--filter TEXT]
+//                         [--threads N] [--scalar] [--out FILE]
+#include "wasm-image-processor.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+struct Options {
+    int maxSize = 7680;      // Largest source edge to run
+    double minTime = 0.5;    // Seconds of samples per case
+    std::string filter;      // Only cases whose name contains this
+    int threads = 1;         // > 1 enables the worker pool
+    bool scalar = false;     // Force the scalar kernels
+    std::string out;
+};
+
+struct SizeCase {
+    int width;
+    int height;
+};
+
+// Square sizes up to 4K, then 8K UHD
+const SizeCase kSizes[] = {
+    {64, 64}, {256, 256}, {1024, 1024}, {2048, 2048}, {4096, 4096}, {7680, 4320},
+};
+
+const char* const kResizeFilters[] = {"lanczos", "bicubic", "bilinear"};
+const int kWebPQualities[] = {50, 75, 90};
+const int kAVIFQualities[] = {50, 75};
+const int kAVIFSpeeds[] = {6, 8, 10};
+const int kJPEGXLQualities[] = {50, 75, 90};
+
+struct Result {
+    std::string name;
+    int width = 0;
+    int height = 0;
+    int iterations = 0;
+    double bestMs = 0;
+    double medianMs = 0;
+    size_t outputBytes = 0;
+    size_t inputBytes = 0;  // Bytes one call codes, for byte-oriented cases
+    bool ok = false;
+};
+
+// Smooth gradients with a little texture and noise, so encoders see
+// something closer to a photo than a flat fill or pure noise
+std::vector<uint8_t> makeImage(int width, int height, int channels) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * channels);
+    uint32_t seed = 0x9E3779B9u;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            const int noise = static_cast<int>(seed >> 29) - 4;
+            const float fx = static_cast<float>(x) / width;
+            const float fy = static_cast<float>(y) / height;
+            const float wave = 24.0f * std::sin(fx * 37.0f) * std::cos(fy * 23.0f);
+            const int values[4] = {
+                static_cast<int>(255.0f * fx + wave) + noise,
+                static_cast<int>(255.0f * fy - wave) + noise,
+                static_cast<int>(128.0f + wave * 2.0f) + noise,
+                255,
+            };
+            uint8_t* px = &pixels[(static_cast<size_t>(y) * width + x) * channels];
+            for (int c = 0; c < channels; c++) {
+                px[c] = static_cast<uint8_t>(std::clamp(values[c], 0, 255));
+            }
+        }
+    }
+    return pixels;
+}
+
+// Run fn until minTime has passed (at least twice, so the first call's
+// warm-up is never the only sample); fn returns the output size or 0
+template<typename Fn>
+Result measure(const std::string& name, int width, int height, double minTime, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    Result result;
+    result.name = name;
+    result.width = width;
+    result.height = height;
+
+    std::vector<double> samples;
+    const auto begin = Clock::now();
+    do {
+        const auto start = Clock::now();
+        const size_t bytes = fn();
+        const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        if (bytes == 0) return result;
+        samples.push_back(elapsed.count());
+        result.outputBytes = bytes;
+    } while (samples.size() < 2 ||
+             std::chrono::duration<double>(Clock::now() - begin).count() < minTime);
+
+    std::sort(samples.begin(), samples.end());
+    result.iterations = static_cast<int>(samples.size());
+    result.bestMs = samples.front();
+    result.medianMs = samples[samples.size() / 2];
+    result.ok = true;
+    return result;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void writeJSON(std::ostream& os, const Options& options, const std::vector<Result>& results) {
+    os << "{\n";
+    os << "  \"config\": {\"simd\": " << (simd::kAvailable && !options.scalar ? "true" : "false")
+       << ", \"threads\": " << options.threads
+       << ", \"webp\": " << (IMAGE_PROCESSOR_HAS_WEBP ? "true" : "false")
+       << ", \"avif\": " << (avif::kAvailable ? "true" : "false")
+       << ", \"minTime\": " << options.minTime << "},\n";
+    os << "  \"results\": [";
+    bool first = true;
+    for (const Result& r : results) {
+        os << (first ? "\n" : ",\n");
+        first = false;
+
+        // Throughput over source pixels, plus over input bytes (MB/s) for
+        // cases that code bytes rather than pixels
+        const double megapixels = static_cast<double>(r.width) * r.height * 1e-6;
+        os << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"width\": " << r.width
+           << ", \"height\": " << r.height;
+        if (r.ok) {
+            const double seconds = r.medianMs * 1e-3;
+            os << ", \"iterations\": " << r.iterations << ", \"bestMs\": " << r.bestMs
+               << ", \"medianMs\": " << r.medianMs << ", \"mpps\": " << megapixels / seconds;
+            if (r.inputBytes > 0) {
+                os << ", \"inputBytes\": " << r.inputBytes << ", \"mbps\": " << r.inputBytes * 1e-6 / seconds;
+            }
+            os << ", \"outputBytes\": " << r.outputBytes;
+        } else {
+            os << ", \"skipped\": true";
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--max-size" && hasValue) {
+            options.maxSize = std::atoi(argv[++i]);
+        } else if (arg == "--min-time" && hasValue) {
+            options.minTime = std::atof(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--scalar") {
+            options.scalar = true;
+        } else if (arg == "--out" && hasValue) {
+            options.out = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--max-size N] [--min-time S] [--filter TEXT] [--threads N] [--scalar] [--out FILE]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 2;
+
+    std::vector<Result> results;
+    auto wanted = [&](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    auto run = [&](const std::string& name, int width, int height, auto&& fn, size_t inputBytes = 0) {
+        if (!wanted(name)) return;
+        results.push_back(measure(name, width, height, options.minTime, fn));
+        results.back().inputBytes = inputBytes;
+        std::cerr << name << " " << width << "x" << height
+                  << (results.back().ok ? "" : " (skipped)") << "\n";
+    };
+
+    for (const SizeCase& size : kSizes) {
+        if (std::max(size.width, size.height) > options.maxSize) continue;
+
+        const std::vector<uint8_t> image = makeImage(size.width, size.height, 4);
+        ImageProcessor processor;
+        processor.setUseSimd(!options.scalar);
+        processor.setThreading(options.threads > 1, options.threads);
+        processor.setEncodeCacheEnabled(false);
+        processor.loadImageView(reinterpret_cast<uintptr_t>(image.data()), static_cast<int>(image.size()),
+                                size.width, size.height, 4);
+
+        // Downscale by half, the common thumbnail/srcset step
+        for (const char* filter : kResizeFilters) {
+            run(std::string("resize/") + filter, size.width, size.height, [&] {
+                return processor.resize(size.width / 2, size.height / 2, filter).size();
+            });
+        }
+
+        for (int quality : kWebPQualities) {
+            run("encode/webp/q" + std::to_string(quality), size.width, size.height, [&] {
+                return processor.encodeWebP(quality, false).size();
+            });
+        }
+        run("encode/webp/lossless", size.width, size.height, [&] {
+            return processor.encodeWebP(100, true).size();
+        });
+
+        // Re-optimising an existing WebP: full-size decode vs scaled on
+        // decode to 1/8 width. outputBytes reports the WebP input size.
+        const std::vector<uint8_t> webp = processor.encodeWebP(80, false);
+        ImageProcessor decoder;
+        decoder.setThreading(options.threads > 1, options.threads);
+        for (int divisor : {1, 8}) {
+            WebPDecodeOptions decode;
+            decode.width = std::max(1, size.width / divisor);
+            run("decode/webp/scale" + std::to_string(divisor), size.width, size.height, [&] {
+                const bool ok = !webp.empty() &&
+                    decoder.loadWebP(reinterpret_cast<uintptr_t>(webp.data()), static_cast<int>(webp.size()),
+                                     decode);
+                return ok ? webp.size() : size_t(0);
+            });
+        }
+
+        for (int speed : kAVIFSpeeds) {
+            processor.setAVIFOptions(speed, -1, -1, 0);
+            for (int quality : kAVIFQualities) {
+                run("encode/avif/s" + std::to_string(speed) + "/q" + std::to_string(quality),
+                    size.width, size.height, [&] {
+                        return processor.encodeAVIF(quality).size();
+                    });
+            }
+        }
+
+        for (int quality : kJPEGXLQualities) {
+            run("encode/jpegxl/q" + std::to_string(quality), size.width, size.height, [&] {
+                return processor.encodeJPEGXL(quality).size();
+            });
+        }
+        
+        // Quality searched under an MS-SSIM target, up to seven trial encodes
+        processor.setSSIMTarget(0.98f);
+        run("encode/jpegxl/ssim98", size.width, size.height, [&] {
+            return processor.encodeJPEGXL(90).size();
+        });
+        processor.setSSIMTarget(0);
+        
+        // Analysis is cached per source, so each sample reloads the view.
+        // outputBytes reports the input size for both.
+        run("analyze", size.width, size.height, [&] {
+            processor.loadImageView(reinterpret_cast<uintptr_t>(image.data()), static_cast<int>(image.size()),
+                                    size.width, size.height, 4);
+            processor.analyzeImage();
+            return image.size();
+        });
+        run("ssim", size.width, size.height, [&] {
+            const float score = processor.compareSSIM(reinterpret_cast<uintptr_t>(image.data()),
+                                                      static_cast<int>(image.size()), size.width, size.height, 4);
+            return score >= 0.0f ? image.size() : size_t(0);
+        });
+
+        // srcset pyramid: five widths from one load, cascaded vs each from
+        // the full-size source
+        const std::vector<int> variantWidths = {size.width / 2, size.width / 3, size.width / 4,
+                                                size.width / 6, size.width / 8};
+        ImagePipeline variants;
+        variants.encode("raw", 0, false);
+        run("variants/cascade", size.width, size.height, [&] {
+            size_t bytes = 0;
+            for (const auto& variant : processor.generateVariants(variants, variantWidths)) bytes += variant.size();
+            return bytes;
+        });
+        run("variants/direct", size.width, size.height, [&] {
+            size_t bytes = 0;
+            for (int w : variantWidths) {
+                bytes += processor.resize(w, std::max(1, w * size.height / size.width), "lanczos").size();
+            }
+            return bytes;
+        });
+
+        // Entropy coder alone on zigzag-mapped horizontal residuals, the
+        // kind of data the JPEG XL path feeds it
+        std::vector<uint8_t> residuals(image.size());
+        for (size_t i = 0; i < image.size(); i++) {
+            const int delta = static_cast<int8_t>(i >= 4 ? image[i] - image[i - 4] : image[i]);
+            residuals[i] = static_cast<uint8_t>(delta >= 0 ? 2 * delta : -2 * delta - 1);
+        }
+        std::vector<uint8_t> coded;
+        std::vector<uint8_t> decoded;
+        run("rans/encode", size.width, size.height, [&] {
+            coded.clear();
+            rans::encode(residuals.data(), residuals.size(), coded);
+            return coded.size();
+        }, residuals.size());
+        run("rans/decode", size.width, size.height, [&] {
+            return rans::decode(coded.data(), coded.size(), decoded) ? decoded.size() : 0;
+        }, residuals.size());
+    }
+
+    if (options.out.empty()) {
+        writeJSON(std::cout, options, results);
+        return 0;
+    }
+
+    std::ofstream file(options.out);
+    writeJSON(file, options, results);
+    return file ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+// Native stand-in for <emscripten.h>
+//
+// Lets ImageProcessor build as an ordinary Linux library (benchmarks,
+// profilers, sanitizers). Only what the engine uses is provided.
+#pragma once
+
+#define EMSCRIPTEN_KEEPALIVE __attribute__((used))
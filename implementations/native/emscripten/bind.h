@@ -0,0 +1,121 @@
+// Native stand-in for <emscripten/bind.h>
+//
+// val is an inert placeholder and the registration helpers do nothing, so
+// the binding code still compiles. Native callers use the std::vector
+// entry points; the *View methods return an empty val.
+#pragma once
+
+#include <cstddef>
+
+namespace emscripten {
+
+class val {
+public:
+    val() = default;
+
+    template<typename T>
+    explicit val(T&&) {}
+
+    static val object() {
+        return val();
+    }
+
+    static val array() {
+        return val();
+    }
+
+    static val null() {
+        return val();
+    }
+
+    static val undefined() {
+        return val();
+    }
+
+    template<typename K, typename V>
+    void set(const K&, const V&) {}
+
+    template<typename T>
+    T as() const {
+        return T();
+    }
+
+    bool isUndefined() const {
+        return true;
+    }
+};
+
+template<typename T>
+struct memory_view {
+    size_t size;
+    const T* data;
+};
+
+template<typename T>
+memory_view<T> typed_memory_view(size_t size, const T* data) {
+    return {size, data};
+}
+
+struct allow_raw_pointers {};
+
+template<typename... Bases>
+struct base {};
+
+template<typename C, typename B = base<>>
+class class_ {
+public:
+    explicit class_(const char*) {}
+
+    template<typename... Args, typename... Policies>
+    class_& constructor(Policies...) {
+        return *this;
+    }
+
+    template<typename F, typename... Policies>
+    class_& function(const char*, F, Policies...) {
+        return *this;
+    }
+
+    template<typename F, typename... Policies>
+    class_& class_function(const char*, F, Policies...) {
+        return *this;
+    }
+
+    template<typename F>
+    class_& property(const char*, F) {
+        return *this;
+    }
+};
+
+template<typename T>
+class value_object {
+public:
+    explicit value_object(const char*) {}
+
+    template<typename F>
+    value_object& field(const char*, F) {
+        return *this;
+    }
+};
+
+template<typename T>
+class enum_ {
+public:
+    explicit enum_(const char*) {}
+
+    enum_& value(const char*, T) {
+        return *this;
+    }
+};
+
+template<typename T>
+void register_vector(const char*) {}
+
+template<typename F, typename... Policies>
+void function(const char*, F, Policies...) {}
+
+} // namespace emscripten
+
+// The registration body is compiled (so bindings stay type-checked) but
+// never runs
+#define EMSCRIPTEN_BINDINGS(name) [[maybe_unused]] static void emscripten_bindings_##name()
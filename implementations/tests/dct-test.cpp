@@ -0,0 +1,107 @@
+// Factorized DCT checks (wasm-dct.h)
+//
+// The float transforms must match a direct double-precision DCT-II, the
+// fixed-point transforms must stay within 1.5 of it (Q12 tables on
+// coefficients up to 255 * N), and both must round-trip 8-bit samples. The
+// processor's verifyDCT binding is checked for both modes as well.
+#include "wasm-image-processor.h"
+#include "test-support.h"
+
+#include <cmath>
+
+namespace {
+
+// Orthonormal 2D DCT-II of an N x N block, straight from the definition
+template <int N>
+void referenceDCT(const float* in, double* out) {
+    for (int u = 0; u < N; u++) {
+        for (int v = 0; v < N; v++) {
+            double sum = 0.0;
+            for (int y = 0; y < N; y++) {
+                for (int x = 0; x < N; x++) {
+                    sum += in[y * N + x] * std::cos((2 * x + 1) * v * dct::kPi / (2 * N)) *
+                           std::cos((2 * y + 1) * u * dct::kPi / (2 * N));
+                }
+            }
+            const double cu = u == 0 ? std::sqrt(1.0 / N) : std::sqrt(2.0 / N);
+            const double cv = v == 0 ? std::sqrt(1.0 / N) : std::sqrt(2.0 / N);
+            out[u * N + v] = cu * cv * sum;
+        }
+    }
+}
+
+template <int N>
+void checkSize(test::Random& random) {
+    constexpr float fraction = 1 << dct::kFixedFraction;
+    float worstFloat = 0.0f;
+    float worstFixed = 0.0f;
+    float worstFixedRoundTrip = 0.0f;
+
+    for (int trial = 0; trial < 16; trial++) {
+        float samples[N * N];
+        int32_t fixedSamples[N * N];
+        for (int i = 0; i < N * N; i++) {
+            fixedSamples[i] = random.byte();
+            samples[i] = static_cast<float>(fixedSamples[i]);
+        }
+
+        double expected[N * N];
+        referenceDCT<N>(samples, expected);
+
+        for (bool vectorize : {false, true}) {
+            float block[N * N];
+            std::copy(samples, samples + N * N, block);
+            dct::transform2D<N, false>(block, vectorize);
+            for (int i = 0; i < N * N; i++) {
+                worstFloat = std::max(worstFloat, static_cast<float>(std::abs(block[i] - expected[i])));
+            }
+
+            dct::transform2D<N, true>(block, vectorize);
+            for (int i = 0; i < N * N; i++) {
+                CHECK(std::abs(block[i] - samples[i]) < 0.01f);
+            }
+        }
+
+        int32_t coefficients[N * N];
+        dct::forwardFixed2D<N>(fixedSamples, coefficients);
+        for (int i = 0; i < N * N; i++) {
+            const double error = std::abs(coefficients[i] / fraction - expected[i]);
+            worstFixed = std::max(worstFixed, static_cast<float>(error));
+        }
+
+        int32_t restored[N * N];
+        dct::inverseFixed2D<N>(coefficients, restored);
+        for (int i = 0; i < N * N; i++) {
+            const int error = std::abs(restored[i] - fixedSamples[i]);
+            worstFixedRoundTrip = std::max(worstFixedRoundTrip, static_cast<float>(error));
+        }
+    }
+
+    std::printf("%2d point: float %.5f, fixed %.4f, fixed round trip %.0f\n", N, worstFloat, worstFixed,
+                worstFixedRoundTrip);
+    CHECK(worstFloat < 0.01f);
+    CHECK(worstFixed < 1.5f);
+    CHECK(worstFixedRoundTrip <= 1.0f);
+}
+
+} // namespace
+
+int main() {
+    test::Random random(4);
+    checkSize<4>(random);
+    checkSize<8>(random);
+    checkSize<16>(random);
+    checkSize<32>(random);
+
+    // verifyDCT compares the selected fast path with the O(N^4) reference
+    ImageProcessor processor;
+    for (int size : {4, 8, 16, 32}) {
+        const float floatError = processor.verifyDCT(size, static_cast<int>(DCTMode::Float));
+        const float fixedError = processor.verifyDCT(size, static_cast<int>(DCTMode::FixedPoint));
+        std::printf("verifyDCT %2d: float %.4f, fixed %.4f\n", size, floatError, fixedError);
+        CHECK(floatError >= 0.0f && floatError < 0.05f);
+        CHECK(fixedError >= 0.0f && fixedError < 1.5f);
+    }
+
+    return test::testResult();
+}
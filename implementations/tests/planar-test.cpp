@@ -0,0 +1,179 @@
+// Planar YUV conversion checks (wasm-planar.h, wasm-simd.h)
+//
+// The vector luma and chroma rows must match the scalar BT.601 formulas
+// for RGB and RGBA at every width around the vector step, without reading
+// past the row. With libwebp, lossy encodes from the planes are compared
+// with the ARGB import that uses sharp YUV at method 6: setSharpYUV must
+// produce exactly that encode, and on photo-like content the planar path
+// must not lose MS-SSIM on any colour channel. Saturated strokes are only
+// reported, as the planar path loses red and blue there by design.
+#include "wasm-image-processor.h"
+#include "test-support.h"
+
+struct ImageProcessorTestAccess {
+#if IMAGE_PROCESSOR_HAS_WEBP
+    static void configureWebP(ImageProcessor& processor, WebPConfig& config, int quality) {
+        processor.configureWebP(config, quality, false, 6);
+    }
+#endif
+};
+
+namespace {
+
+void checkRows(test::Random& random) {
+    int mismatches = 0;
+    for (int stride : {3, 4}) {
+        for (int width = 1; width <= 40; width++) {
+            // Exactly sized, so out-of-row loads show up under ASan
+            const std::vector<uint8_t> row0 = random.bytes(static_cast<size_t>(width) * stride);
+            const std::vector<uint8_t> row1 = random.bytes(static_cast<size_t>(width) * stride);
+
+            std::vector<uint8_t> luma(width);
+            simd::lumaRow(row0.data(), width, stride, luma.data());
+            for (int x = 0; x < width; x++) {
+                const uint8_t* p = &row0[static_cast<size_t>(x) * stride];
+                if (luma[x] != simd::luma(p[0], p[1], p[2])) mismatches++;
+            }
+
+            const int chromaWidth = (width + 1) / 2;
+            std::vector<uint8_t> u(chromaWidth);
+            std::vector<uint8_t> v(chromaWidth);
+            simd::chromaRow(row0.data(), row1.data(), width, stride, u.data(), v.data());
+            for (int cx = 0; cx < chromaWidth; cx++) {
+                int sum[3] = {};
+                for (int x : {cx * 2, std::min(cx * 2 + 1, width - 1)}) {
+                    const size_t i = static_cast<size_t>(x) * stride;
+                    for (int c = 0; c < 3; c++) sum[c] += row0[i + c] + row1[i + c];
+                }
+                if (u[cx] != simd::chromaBlue(sum[0], sum[1], sum[2])) mismatches++;
+                if (v[cx] != simd::chromaRed(sum[0], sum[1], sum[2])) mismatches++;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+#if IMAGE_PROCESSOR_HAS_WEBP
+constexpr int kSize = 256;
+
+// Smooth colour ramps with a little noise, like a photo
+std::vector<uint8_t> photo(test::Random& random) {
+    std::vector<uint8_t> rgb(kSize * kSize * 3);
+    for (int y = 0; y < kSize; y++) {
+        for (int x = 0; x < kSize; x++) {
+            uint8_t* p = &rgb[(y * kSize + x) * 3];
+            const int noise = static_cast<int>(random.next() % 9) - 4;
+            p[0] = static_cast<uint8_t>(std::clamp(x + noise, 0, 255));
+            p[1] = static_cast<uint8_t>(std::clamp(y + noise, 0, 255));
+            p[2] = static_cast<uint8_t>(std::clamp((x + y) / 2 + noise, 0, 255));
+        }
+    }
+    return rgb;
+}
+
+// Thin saturated red and blue strokes on white and black, where chroma
+// subsampling hurts most
+std::vector<uint8_t> graphic() {
+    std::vector<uint8_t> rgb(kSize * kSize * 3);
+    for (int y = 0; y < kSize; y++) {
+        for (int x = 0; x < kSize; x++) {
+            uint8_t* p = &rgb[(y * kSize + x) * 3];
+            const uint8_t background = y < kSize / 2 ? 255 : 0;
+            p[0] = p[1] = p[2] = background;
+            if ((x / 3 + y / 7) % 4 == 0) {
+                p[0] = 255;
+                p[1] = p[2] = 0;
+            } else if ((x + 2 * y) % 11 < 2) {
+                p[0] = p[1] = 0;
+                p[2] = 255;
+            }
+        }
+    }
+    return rgb;
+}
+
+std::vector<uint8_t> encodeARGB(ImageProcessor& processor, const std::vector<uint8_t>& rgb, int quality) {
+    WebPConfig config;
+    ImageProcessorTestAccess::configureWebP(processor, config, quality);
+    WebPPicture picture;
+    WebPPictureInit(&picture);
+    picture.width = kSize;
+    picture.height = kSize;
+    picture.use_argb = 1;
+    WebPPictureImportRGB(&picture, rgb.data(), kSize * 3);
+
+    WebPMemoryWriter writer;
+    WebPMemoryWriterInit(&writer);
+    picture.writer = WebPMemoryWrite;
+    picture.custom_ptr = &writer;
+    std::vector<uint8_t> out;
+    if (WebPEncode(&config, &picture)) out.assign(writer.mem, writer.mem + writer.size);
+    WebPMemoryWriterClear(&writer);
+    WebPPictureFree(&picture);
+    return out;
+}
+
+std::vector<uint8_t> decodeRGB(const std::vector<uint8_t>& webp) {
+    int width = 0;
+    int height = 0;
+    uint8_t* rgb = WebPDecodeRGB(webp.data(), webp.size(), &width, &height);
+    if (rgb == nullptr) return {};
+    std::vector<uint8_t> out;
+    if (width == kSize && height == kSize) out.assign(rgb, rgb + kSize * kSize * 3);
+    WebPFree(rgb);
+    return out;
+}
+
+// MS-SSIM of one colour channel of `decoded` against the same channel of rgb
+float channelSSIM(const std::vector<uint8_t>& rgb, const std::vector<uint8_t>& decoded, int channel) {
+    std::vector<uint8_t> a(kSize * kSize);
+    std::vector<uint8_t> b(kSize * kSize);
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] = rgb[i * 3 + channel];
+        b[i] = decoded[i * 3 + channel];
+    }
+    ImageProcessor processor;
+    processor.loadImage(reinterpret_cast<uintptr_t>(a.data()), a.size(), kSize, kSize, 1);
+    return processor.compareSSIM(reinterpret_cast<uintptr_t>(b.data()), b.size(), kSize, kSize, 1);
+}
+
+void compareWithARGB(const char* name, const std::vector<uint8_t>& rgb, bool checkPlanar) {
+    ImageProcessor processor;
+    processor.setEncodeCacheEnabled(false);
+    CHECK(processor.loadImage(reinterpret_cast<uintptr_t>(rgb.data()), rgb.size(), kSize, kSize, 3));
+
+    for (int quality : {50, 80}) {
+        const std::vector<uint8_t> planarWebP = processor.encodeWebP(quality);
+        const std::vector<uint8_t> argbWebP = encodeARGB(processor, rgb, quality);
+        processor.setSharpYUV(true);
+        CHECK(processor.encodeWebP(quality) == argbWebP);
+        processor.setSharpYUV(false);
+        const std::vector<uint8_t> planar = decodeRGB(planarWebP);
+        const std::vector<uint8_t> argb = decodeRGB(argbWebP);
+        CHECK(!planar.empty() && !argb.empty());
+        if (planar.empty() || argb.empty()) continue;
+
+        for (int channel = 0; channel < 3; channel++) {
+            const float planarSSIM = channelSSIM(rgb, planar, channel);
+            const float argbSSIM = channelSSIM(rgb, argb, channel);
+            std::printf("%s q%d %c: planar %.4f (%zu bytes), sharp-YUV ARGB %.4f (%zu bytes)\n", name, quality,
+                        "RGB"[channel], planarSSIM, planarWebP.size(), argbSSIM, argbWebP.size());
+            if (checkPlanar) CHECK(planarSSIM >= argbSSIM - 0.01f);
+        }
+    }
+}
+#endif
+
+} // namespace
+
+int main() {
+    test::Random random(17);
+    checkRows(random);
+#if IMAGE_PROCESSOR_HAS_WEBP
+    compareWithARGB("photo", photo(random), true);
+    compareWithARGB("graphic", graphic(), false);
+#else
+    std::printf("built without libwebp: skipping the ARGB comparison\n");
+#endif
+    return test::testResult();
+}
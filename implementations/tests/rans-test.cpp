@@ -0,0 +1,128 @@
+// rANS coder checks (wasm-rans.h)
+//
+// Round trips over random, constant, empty, sparse and 0xFF-heavy inputs
+// at lengths around the lane count; the encoder's reciprocal division
+// against real division for every frequency; malformed streams, which
+// must be rejected without over-allocating; and symbol counts past 32 bits.
+#include "wasm-rans.h"
+#include "test-support.h"
+
+namespace {
+
+bool roundTrips(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> coded;
+    rans::encode(data.data(), data.size(), coded);
+    std::vector<uint8_t> decoded;
+    return rans::decode(coded.data(), coded.size(), decoded) && decoded == data;
+}
+
+void checkRoundTrips() {
+    test::Random random(9);
+    for (size_t size : {0, 1, 7, 8, 9, 63, 1000, 65537}) {
+        CHECK(roundTrips(random.bytes(size)));
+        CHECK(roundTrips(std::vector<uint8_t>(size, 0)));
+        CHECK(roundTrips(std::vector<uint8_t>(size, 0xFF)));
+
+        // Mostly 0xFF, the rest random; and mostly zero with rare spikes
+        std::vector<uint8_t> heavy(size);
+        std::vector<uint8_t> sparse(size);
+        for (size_t i = 0; i < size; i++) {
+            heavy[i] = random.next() % 16 ? 0xFF : random.byte();
+            sparse[i] = random.next() % 64 ? 0 : random.byte();
+        }
+        CHECK(roundTrips(heavy));
+        CHECK(roundTrips(sparse));
+    }
+
+    // A constant input still costs a little per symbol
+    std::vector<uint8_t> coded;
+    const std::vector<uint8_t> constant(1 << 20, 7);
+    rans::encode(constant.data(), constant.size(), coded);
+    CHECK(coded.size() < constant.size() / 64);
+}
+
+// The division-free encoder step must match x / freq * scale + x % freq +
+// start for every frequency, over the states it can see: [8 * freq, xMax)
+void checkReciprocals() {
+    test::Random random(3);
+    int mismatches = 0;
+    for (uint32_t freq = 1; freq < rans::kProbScale; freq++) {
+        const uint32_t start = rans::kProbScale - freq;
+        rans::EncodeSymbol symbol;
+        symbol.init(start, freq);
+        auto check = [&](uint32_t x) {
+            const uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(x) * symbol.rcpFreq) >> 32) >>
+                               symbol.rcpShift;
+            const uint32_t state = x + symbol.bias + q * symbol.cmplFreq;
+            if (state != x / freq * rans::kProbScale + x % freq + start) mismatches++;
+        };
+
+        // Either side of the multiples at the ends of the range, plus random states
+        for (uint32_t k : {8u, 9u, symbol.xMax / freq - 2, symbol.xMax / freq - 1}) {
+            for (uint32_t x : {k * freq - 1, k * freq, k * freq + freq - 1}) {
+                if (x >= 8 * freq && x < symbol.xMax) check(x);
+            }
+        }
+        for (int i = 0; i < 256; i++) check(8 * freq + random.next() % (symbol.xMax - 8 * freq));
+    }
+    CHECK(mismatches == 0);
+}
+
+void checkMalformed() {
+    std::vector<uint8_t> decoded;
+
+    // A 5-byte header claiming ~4G symbols, then nothing
+    const uint8_t huge[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+    CHECK(!rans::decode(huge, sizeof(huge), decoded));
+
+    // The same claim in front of valid tables and states
+    test::Random random(5);
+    const std::vector<uint8_t> data = random.bytes(100);
+    std::vector<uint8_t> coded;
+    rans::encode(data.data(), data.size(), coded);
+    std::vector<uint8_t> inflated = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+    inflated.insert(inflated.end(), coded.begin() + 1, coded.end());
+    CHECK(!rans::decode(inflated.data(), inflated.size(), decoded));
+    CHECK(decoded.size() < (1u << 20));
+
+    // Every truncation fails cleanly
+    for (size_t size = 0; size < coded.size(); size++) {
+        std::vector<uint8_t> out;
+        CHECK(!rans::decode(coded.data(), size, out) || out != data);
+    }
+}
+
+// Memory64 builds can code over 4 GiB in one call, so the count is a
+// 64-bit varint. A count that a 32-bit header would wrap to a valid one
+// must be read in full and rejected, not decode the short stream.
+void checkLargeCounts() {
+    for (uint64_t value : {0ull, 0xFFFFFFFFull, 0x100000000ull, 0x100000005ull, (1ull << 40) + 3, ~0ull}) {
+        std::vector<uint8_t> bytes;
+        rans::putVarint(bytes, value);
+        const uint8_t* p = bytes.data();
+        uint64_t read = 0;
+        CHECK(rans::getVarint(p, bytes.data() + bytes.size(), read) && read == value);
+        CHECK(p == bytes.data() + bytes.size());
+    }
+
+    test::Random random(7);
+    const std::vector<uint8_t> data = random.bytes(5);
+    std::vector<uint8_t> coded;
+    rans::encode(data.data(), data.size(), coded);
+    CHECK(coded[0] == 5);
+    std::vector<uint8_t> wrapped;
+    rans::putVarint(wrapped, 0x100000005ull);
+    wrapped.insert(wrapped.end(), coded.begin() + 1, coded.end());
+    std::vector<uint8_t> decoded;
+    CHECK(!rans::decode(wrapped.data(), wrapped.size(), decoded));
+}
+
+} // namespace
+
+int main() {
+    checkRoundTrips();
+    checkReciprocals();
+    checkMalformed();
+    checkLargeCounts();
+    return test::testResult();
+}
@@ -0,0 +1,191 @@
+// Separable resampler checks
+//
+// Resizes must not depend on what the processor resized before: results
+// are compared with those of a fresh processor, including after sequences
+// that evict the cached weight tables a resize or an open stream is still
+// using. The column-tiled vertical pass must match a full-row pass byte for
+// byte.
+#include "wasm-image-processor.h"
+#include "test-support.h"
+
+struct ImageProcessorTestAccess {
+    static const std::vector<uint8_t>& output(const ImageProcessor& processor) {
+        return processor.outputBuffer;
+    }
+
+    static std::shared_ptr<const ResampleWeights> weights(ImageProcessor& processor, int srcSize, int dstSize,
+                                                          ResizeFilter filter) {
+        return processor.getResampleWeights(srcSize, dstSize, filter);
+    }
+
+    static int tileEnd(const ResampleWeights& horizontal, int xBegin, int channels) {
+        return ImageProcessor::resampleTileEnd(horizontal, xBegin, channels);
+    }
+
+    // resampleRows over the whole frame, which goes a tile at a time
+    template <int Channels>
+    static std::vector<uint8_t> tiled(const ImageView& src, const ResampleWeights& horizontal,
+                                      const ResampleWeights& vertical, bool vectorize) {
+        std::vector<float> column(ImageProcessor::resampleColumnLength(horizontal, Channels));
+        std::vector<uint8_t> dst(static_cast<size_t>(horizontal.dstSize) * vertical.dstSize * Channels);
+        const size_t dstStride = static_cast<size_t>(horizontal.dstSize) * Channels;
+        ImageProcessor::resampleRows<Channels>(src, column.data(), dst.data(), dstStride, 0, vertical.dstSize,
+                                               horizontal, vertical, vectorize);
+        return dst;
+    }
+
+    // The same resize as one vertical pass over each full source row, then
+    // the horizontal pass over every output column
+    template <int Channels>
+    static std::vector<uint8_t> untiled(const ImageView& src, const ResampleWeights& horizontal,
+                                        const ResampleWeights& vertical, bool vectorize) {
+        std::vector<float> column(ImageProcessor::resampleColumnLength(horizontal, Channels));
+        std::vector<uint8_t> dst(static_cast<size_t>(horizontal.dstSize) * vertical.dstSize * Channels);
+        const int rowLength = src.width * Channels;
+        for (int y = 0; y < vertical.dstSize; y++) {
+            std::fill(column.begin(), column.begin() + rowLength, 0.0f);
+            for (int t = 0; t < vertical.count[y]; t++) {
+                const float weight = vertical.weights[static_cast<size_t>(y) * vertical.maxTaps + t];
+                ImageProcessor::accumulateRow(column.data(), src.row(vertical.start[y] + t), rowLength, weight,
+                                              vectorize);
+            }
+            uint8_t* dstRow = dst.data() + static_cast<size_t>(y) * horizontal.dstSize * Channels;
+            ImageProcessor::filterRow<Channels>(column.data(), dstRow, horizontal, 0, horizontal.dstSize, vectorize);
+        }
+        return dst;
+    }
+};
+
+namespace {
+
+std::vector<uint8_t> resizeFresh(const std::vector<uint8_t>& pixels, int width, int height, int channels,
+                                 int newWidth, int newHeight, const char* filter) {
+    ImageProcessor processor;
+    processor.setThreading(false, 1);
+    processor.loadImage(reinterpret_cast<uintptr_t>(pixels.data()), pixels.size(), width, height, channels);
+    return processor.resize(newWidth, newHeight, filter);
+}
+
+// Eight square sizes fill the weight cache; a non-square resize then needs
+// two new tables, and fetching the second evicts the first
+void checkWeightEviction() {
+    const int width = 1000;
+    const int height = 1000;
+    const int channels = 3;
+    test::Random random(1);
+    const std::vector<uint8_t> pixels = random.bytes(static_cast<size_t>(width) * height * channels);
+
+    ImageProcessor processor;
+    processor.setThreading(false, 1);
+    CHECK(processor.loadImage(reinterpret_cast<uintptr_t>(pixels.data()), pixels.size(), width, height, channels));
+
+    const std::vector<uint8_t> first = processor.resize(500, 500, "lanczos");
+    CHECK(first == resizeFresh(pixels, width, height, channels, 500, 500, "lanczos"));
+    for (int size : {400, 300, 250, 200, 150, 100, 50}) {
+        CHECK(processor.resize(size, size, "lanczos").size() == static_cast<size_t>(size) * size * channels);
+    }
+    const std::vector<uint8_t> last = processor.resize(500, 333, "lanczos");
+    CHECK(last == resizeFresh(pixels, width, height, channels, 500, 333, "lanczos"));
+}
+
+// Push a frame through a raw resize stream in two halves, optionally
+// filling the weight cache with other resizes in between
+std::vector<uint8_t> streamResize(const std::vector<uint8_t>& pixels, int width, int height, int channels,
+                                  bool evictBetweenPushes) {
+    ImageProcessor processor;
+    processor.setThreading(false, 1);
+    ImagePipeline pipeline;
+    pipeline.resize(width / 3, height / 3, "lanczos");
+    pipeline.encode("raw", 0, false);
+    CHECK(processor.beginStream(width, height, channels, pipeline));
+
+    std::vector<uint8_t> rows;
+    auto take = [&] {
+        processor.takeStreamRowsView();
+        const std::vector<uint8_t>& taken = ImageProcessorTestAccess::output(processor);
+        rows.insert(rows.end(), taken.begin(), taken.end());
+    };
+
+    const size_t rowBytes = static_cast<size_t>(width) * channels;
+    const int half = height / 2;
+    processor.pushRows(reinterpret_cast<uintptr_t>(pixels.data()), rowBytes * half, half);
+    take();
+
+    if (evictBetweenPushes) {
+        const uintptr_t data = reinterpret_cast<uintptr_t>(pixels.data());
+        CHECK(processor.loadImage(data, pixels.size(), width, height, channels));
+        for (int size : {90, 80, 70, 60, 50, 40, 30, 20, 10}) {
+            processor.resize(size, size, "bicubic");
+        }
+    }
+
+    processor.pushRows(reinterpret_cast<uintptr_t>(pixels.data() + rowBytes * half), rowBytes * (height - half),
+                       height - half);
+    take();
+    processor.finishStreamView();
+    return rows;
+}
+
+void checkStreamWeights() {
+    const int width = 300;
+    const int height = 200;
+    const int channels = 4;
+    test::Random random(2);
+    const std::vector<uint8_t> pixels = random.bytes(static_cast<size_t>(width) * height * channels);
+
+    const std::vector<uint8_t> expected = streamResize(pixels, width, height, channels, false);
+    CHECK(expected.size() == static_cast<size_t>(width / 3) * (height / 3) * channels);
+    CHECK(streamResize(pixels, width, height, channels, true) == expected);
+}
+
+// Source floats the vertical pass accumulates per output row, over all
+// tiles, relative to one full row
+double tiledWork(const ResampleWeights& horizontal, int channels) {
+    int span = 0;
+    for (int xBegin = 0; xBegin < horizontal.dstSize;) {
+        const int xEnd = ImageProcessorTestAccess::tileEnd(horizontal, xBegin, channels);
+        span += std::min(horizontal.start[xEnd - 1] + horizontal.maxTaps, horizontal.srcSize) -
+                horizontal.start[xBegin];
+        xBegin = xEnd;
+    }
+    return static_cast<double>(span) / horizontal.srcSize;
+}
+
+// Wide rows go through the vertical pass a tile of output columns at a
+// time; the result must be byte-identical to full-row passes, and on large
+// downscales the overlap between tiles must stay small
+template <int Channels>
+void checkTiling(test::Random& random) {
+    const int height = 12;
+    ImageProcessor processor;
+    for (ResizeFilter filter : {ResizeFilter::Lanczos, ResizeFilter::Bicubic}) {
+        for (auto [width, newWidth] : {std::pair{8000, 61}, std::pair{9000, 1000}, std::pair{6001, 5999},
+                                       std::pair{5000, 10000}, std::pair{20000, 150}}) {
+            const std::vector<uint8_t> pixels = random.bytes(static_cast<size_t>(width) * height * Channels);
+            const ImageView src{pixels.data(), width, height, Channels, static_cast<size_t>(width) * Channels};
+            const auto horizontal = ImageProcessorTestAccess::weights(processor, width, newWidth, filter);
+            const auto vertical = ImageProcessorTestAccess::weights(processor, height, 5, filter);
+
+            CHECK(ImageProcessorTestAccess::tileEnd(*horizontal, 0, Channels) < newWidth);
+            CHECK(tiledWork(*horizontal, Channels) < 1.2);
+            for (bool vectorize : {false, true}) {
+                CHECK(ImageProcessorTestAccess::tiled<Channels>(src, *horizontal, *vertical, vectorize) ==
+                      ImageProcessorTestAccess::untiled<Channels>(src, *horizontal, *vertical, vectorize));
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    checkWeightEviction();
+    checkStreamWeights();
+
+    test::Random random(22);
+    checkTiling<1>(random);
+    checkTiling<2>(random);
+    checkTiling<3>(random);
+    checkTiling<4>(random);
+    return test::testResult();
+}
@@ -0,0 +1,60 @@
+// Minimal checks for the native tests
+//
+// Each test is a plain executable run by ctest: CHECK records a failure
+// with its line and keeps going, and main returns testResult() so every
+// failing check in a run is reported at once.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int testResult() {
+    if (failures() == 0) {
+        std::printf("all checks passed\n");
+        return 0;
+    }
+    std::printf("%d check(s) failed\n", failures());
+    return 1;
+}
+
+// Deterministic generator, so failures reproduce
+class Random {
+public:
+    explicit Random(uint32_t seed) : state(seed) {}
+
+    uint32_t next() {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+
+    uint8_t byte() {
+        return static_cast<uint8_t>(next() >> 24);
+    }
+
+    std::vector<uint8_t> bytes(size_t count) {
+        std::vector<uint8_t> data(count);
+        for (auto& b : data) b = byte();
+        return data;
+    }
+
+private:
+    uint32_t state;
+};
+
+} // namespace test
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            test::failures()++;                                                       \
+        }                                                                             \
+    } while (0)
@@ -0,0 +1,169 @@
+// VarDCT quadtree checks
+//
+// TileSums variances must equal a direct two-pass sum over each block, the
+// partition of every 32x32 tile must equal a brute-force quadtree built
+// with the same split rule, and applyVarDCT must transform exactly the
+// reference leaves, single- and multi-threaded, at frame sizes that leave
+// partial tiles and blocks overhanging the edge.
+#include "wasm-image-processor.h"
+#include "test-support.h"
+
+#include <array>
+
+struct ImageProcessorTestAccess {
+    using Leaf = std::array<int, 3>;  // x, y, size
+
+    static std::vector<Leaf> partition(const TileSums& sums) {
+        ImageProcessor::VarDCTBlock blocks[ImageProcessor::kVarDCTMaxLeaves];
+        const int count = ImageProcessor::partitionTile(sums, 0, 0, TileSums::kSize, blocks, 0);
+        std::vector<Leaf> leaves;
+        for (int i = 0; i < count; i++) leaves.push_back({blocks[i].x, blocks[i].y, blocks[i].size});
+        return leaves;
+    }
+
+    static void applyVarDCT(ImageProcessor& processor, std::vector<uint8_t>& data) {
+        processor.applyVarDCT(data.data(), data.size());
+    }
+
+    static void compressBlock(ImageProcessor& processor, std::vector<uint8_t>& data, const Leaf& leaf) {
+        switch (leaf[2]) {
+            case 4: processor.compressBlock<4>(data.data(), data.size(), leaf[0], leaf[1], 0.8f); break;
+            case 8: processor.compressBlock<8>(data.data(), data.size(), leaf[0], leaf[1], 0.8f); break;
+            case 16: processor.compressBlock<16>(data.data(), data.size(), leaf[0], leaf[1], 0.8f); break;
+            case 32: processor.compressBlock<32>(data.data(), data.size(), leaf[0], leaf[1], 0.8f); break;
+        }
+    }
+
+    static constexpr float kSplitVariance = ImageProcessor::kVarDCTSplitVariance;
+    static constexpr float kMinVariance = ImageProcessor::kVarDCTMinVariance;
+    static constexpr int kMinSize = ImageProcessor::kVarDCTMinSize;
+};
+
+namespace {
+
+using Access = ImageProcessorTestAccess;
+using Leaf = Access::Leaf;
+
+struct Frame {
+    std::vector<uint8_t> pixels;
+    int width;
+    int height;
+    int channels;
+
+    uint8_t at(int x, int y) const {
+        return pixels[(static_cast<size_t>(y) * width + x) * channels];
+    }
+};
+
+// Flat squares, noisy columns and a ramp, so every block size shows up
+Frame makeFrame(test::Random& random, int width, int height, int channels) {
+    Frame frame{std::vector<uint8_t>(static_cast<size_t>(width) * height * channels), width, height, channels};
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int v = (x / 40 + y / 30) % 2 ? 200 : 40;
+            if ((x / 16) % 3 == 0) v += random.next() % 120;
+            if (x > 150 && y > 90) v = (x * 5 + y * 3) & 255;
+            uint8_t* pixel = &frame.pixels[(static_cast<size_t>(y) * width + x) * channels];
+            std::fill(pixel, pixel + channels, static_cast<uint8_t>(std::min(v, 255)));
+        }
+    }
+    return frame;
+}
+
+// First-channel variance of a block, summed directly in TileSums' formula
+float blockVariance(const Frame& frame, int x0, int y0, int size) {
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for (int y = y0; y < y0 + size; y++) {
+        for (int x = x0; x < x0 + size; x++) {
+            sum += frame.at(x, y);
+            sumSq += static_cast<double>(frame.at(x, y)) * frame.at(x, y);
+        }
+    }
+    const double count = static_cast<double>(size) * size;
+    const double mean = sum / count;
+    return static_cast<float>(std::max(sumSq / count - mean * mean, 0.0));
+}
+
+// Brute-force quadtree of the block at (x, y), in frame coordinates: keep a
+// block that fits the frame and is smooth enough or minimal, else split it
+void referencePartition(const Frame& frame, int x, int y, int size, std::vector<Leaf>& leaves) {
+    const bool inside = x + size <= frame.width && y + size <= frame.height;
+    if (inside && (size == Access::kMinSize || blockVariance(frame, x, y, size) <= Access::kSplitVariance)) {
+        leaves.push_back({x, y, size});
+        return;
+    }
+    if (size == Access::kMinSize) return;
+    const int half = size / 2;
+    referencePartition(frame, x, y, half, leaves);
+    referencePartition(frame, x + half, y, half, leaves);
+    referencePartition(frame, x, y + half, half, leaves);
+    referencePartition(frame, x + half, y + half, half, leaves);
+}
+
+void checkFrame(const Frame& frame) {
+    const int tile = TileSums::kSize;
+    const size_t stride = static_cast<size_t>(frame.width) * frame.channels;
+    std::vector<uint8_t> expected = frame.pixels;
+    int varianceMismatches = 0;
+    int partitionMismatches = 0;
+    ImageProcessor reference;
+    CHECK(reference.loadImage(reinterpret_cast<uintptr_t>(frame.pixels.data()), frame.pixels.size(), frame.width,
+                              frame.height, frame.channels));
+
+    for (int y0 = 0; y0 < frame.height; y0 += tile) {
+        for (int x0 = 0; x0 < frame.width; x0 += tile) {
+            TileSums sums;
+            sums.build(frame.pixels.data() + y0 * stride + static_cast<size_t>(x0) * frame.channels, stride,
+                       frame.channels, std::min(tile, frame.width - x0), std::min(tile, frame.height - y0));
+            for (int size = Access::kMinSize; size <= tile; size *= 2) {
+                for (int y = 0; y + size <= sums.height; y += size) {
+                    for (int x = 0; x + size <= sums.width; x += size) {
+                        if (sums.variance(x, y, size) != blockVariance(frame, x0 + x, y0 + y, size)) {
+                            varianceMismatches++;
+                        }
+                    }
+                }
+            }
+
+            std::vector<Leaf> expectedLeaves;
+            referencePartition(frame, x0, y0, tile, expectedLeaves);
+            std::vector<Leaf> leaves = Access::partition(sums);
+            for (Leaf& leaf : leaves) {
+                leaf[0] += x0;
+                leaf[1] += y0;
+            }
+            if (leaves != expectedLeaves) partitionMismatches++;
+
+            // The expected frame transforms the reference leaves directly
+            for (const Leaf& leaf : expectedLeaves) {
+                if (blockVariance(frame, leaf[0], leaf[1], leaf[2]) <= Access::kMinVariance) continue;
+                Access::compressBlock(reference, expected, leaf);
+            }
+        }
+    }
+    CHECK(varianceMismatches == 0);
+    CHECK(partitionMismatches == 0);
+
+    for (int threads : {1, 3}) {
+        ImageProcessor processor;
+        processor.setThreading(threads > 1, threads);
+        CHECK(processor.loadImage(reinterpret_cast<uintptr_t>(frame.pixels.data()), frame.pixels.size(),
+                                  frame.width, frame.height, frame.channels));
+        std::vector<uint8_t> data = frame.pixels;
+        Access::applyVarDCT(processor, data);
+        CHECK(data == expected);
+    }
+}
+
+} // namespace
+
+int main() {
+    test::Random random(21);
+    for (int channels : {1, 3, 4}) {
+        for (auto [width, height] : {std::pair{301, 177}, std::pair{64, 64}, std::pair{37, 5}, std::pair{3, 3}}) {
+            checkFrame(makeFrame(random, width, height, channels));
+        }
+    }
+    return test::testResult();
+}
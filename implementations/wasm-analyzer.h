@@ -0,0 +1,183 @@
+// Content analysis for format and quality decisions
+//
+// One pass over the frame gathers a luma histogram, the exact number of
+// distinct colours, alpha usage, edge density and 8x8 luma block variance.
+// Rows are processed in bands of whole 8-row blocks, each into its own
+// BandStats, which are merged at the end; distinct colours are marked in a
+// shared bitmap of the 2^24 RGB values. From these the frame is classed as
+// a photo, a flat graphic or a screenshot (flat areas with sharp text
+// edges), which differ in the format and quality that suit them.
+#pragma once
+
+#include "wasm-planar.h"
+
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+enum class ContentClass { Photo, Graphic, Screenshot };
+
+constexpr const char* kContentClassNames[] = {"photo", "graphic", "screenshot"};
+
+struct ImageAnalysis {
+    uint32_t histogram[256] = {};  // BT.601 luma
+    uint32_t uniqueColors = 0;     // Distinct RGB values (grey levels for 1-2 channels)
+    bool hasAlpha = false;         // Any pixel not fully opaque
+    double transparentFraction = 0;
+    double translucentFraction = 0;  // Alpha strictly between 0 and 255
+    double edgeDensity = 0;          // Share of pixels on a strong luma edge
+    double meanBlockVariance = 0;    // Over whole 8x8 luma blocks
+    double flatBlockFraction = 0;    // Blocks with variance below kFlatVariance
+    double lumaEntropy = 0;          // Bits per pixel of the histogram
+    ContentClass contentClass = ContentClass::Photo;
+};
+
+namespace analyzer {
+
+constexpr int kBlockSize = 8;
+constexpr int kEdgeThreshold = 48;  // |dx| + |dy| of luma
+constexpr double kFlatVariance = 4.0;
+constexpr double kTextEdges = 0.04;        // Edge density of text on a flat background
+constexpr uint32_t kPaletteColors = 1024;  // At most this many colours reads as a palette
+constexpr uint32_t kPaletteGreys = 64;
+constexpr size_t kColorWords = (size_t(1) << 24) / 64;
+
+// Partial results of one band of rows
+struct BandStats {
+    uint32_t histogram[256] = {};
+    uint64_t transparent = 0;
+    uint64_t translucent = 0;
+    uint64_t edges = 0;
+    uint64_t blocks = 0;
+    uint64_t flatBlocks = 0;
+    double varianceSum = 0;
+};
+
+// Set of RGB values seen, shared by every band
+class ColorSet {
+public:
+    ColorSet() : words(kColorWords) {}
+
+    void insert(uint32_t rgb) {
+        const uint64_t bit = uint64_t(1) << (rgb & 63);
+        std::atomic<uint64_t>& word = words[rgb >> 6];
+        if ((word.load(std::memory_order_relaxed) & bit) == 0) {
+            word.fetch_or(bit, std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t count() const {
+        uint32_t total = 0;
+        for (const auto& word : words) {
+            total += static_cast<uint32_t>(std::bitset<64>(word.load(std::memory_order_relaxed)).count());
+        }
+        return total;
+    }
+
+private:
+    std::vector<std::atomic<uint64_t>> words;
+};
+
+// Analyse rows [rowBegin, rowEnd) of a width x height frame. `luma` holds
+// (kBlockSize + 1) * width bytes: the band's current block of luma rows
+// plus the row below it, for vertical gradients.
+inline void analyzeRows(const uint8_t* pixels, size_t stride, int width, int height, int channels,
+                        int rowBegin, int rowEnd, uint8_t* luma, ColorSet& colors, BandStats& stats) {
+    const bool alpha = channels == 2 || channels == 4;
+    const bool colour = channels >= 3;
+    const int blocksX = width / kBlockSize;
+
+    for (int y0 = rowBegin; y0 < rowEnd; y0 += kBlockSize) {
+        const int rows = std::min(kBlockSize, rowEnd - y0);
+        const int lumaRows = std::min(rows + 1, height - y0);
+        for (int r = 0; r < lumaRows; r++) {
+            planar::lumaRow(pixels + static_cast<size_t>(y0 + r) * stride, width, channels, luma + r * width);
+        }
+
+        for (int r = 0; r < rows; r++) {
+            const uint8_t* row = pixels + static_cast<size_t>(y0 + r) * stride;
+            const uint8_t* l = luma + r * width;
+            const uint8_t* below = r + 1 < lumaRows ? l + width : l;
+
+            for (int x = 0; x < width; x++) {
+                stats.histogram[l[x]]++;
+                const int dx = x + 1 < width ? std::abs(l[x + 1] - l[x]) : 0;
+                const int dy = std::abs(below[x] - l[x]);
+                stats.edges += dx + dy >= kEdgeThreshold;
+            }
+
+            for (int x = 0; x < width; x++) {
+                const uint8_t* p = row + x * channels;
+                colors.insert(colour ? (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2] : p[0]);
+            }
+
+            if (alpha) {
+                for (int x = 0; x < width; x++) {
+                    const uint8_t a = row[x * channels + channels - 1];
+                    stats.transparent += a == 0;
+                    stats.translucent += a != 0 && a != 255;
+                }
+            }
+        }
+
+        // Whole blocks only; ragged right and bottom edges are skipped
+        if (rows < kBlockSize) continue;
+        for (int bx = 0; bx < blocksX; bx++) {
+            float sum = 0.0f;
+            float sumSq = 0.0f;
+            for (int r = 0; r < kBlockSize; r++) {
+                simd::sumU8(luma + r * width + bx * kBlockSize, kBlockSize, 1, sum, sumSq);
+            }
+            const double n = kBlockSize * kBlockSize;
+            const double mean = sum / n;
+            const double variance = std::max(sumSq / n - mean * mean, 0.0);
+            stats.blocks++;
+            stats.varianceSum += variance;
+            stats.flatBlocks += variance < kFlatVariance;
+        }
+    }
+}
+
+inline void merge(BandStats& total, const BandStats& band) {
+    for (int i = 0; i < 256; i++) total.histogram[i] += band.histogram[i];
+    total.transparent += band.transparent;
+    total.translucent += band.translucent;
+    total.edges += band.edges;
+    total.blocks += band.blocks;
+    total.flatBlocks += band.flatBlocks;
+    total.varianceSum += band.varianceSum;
+}
+
+// Mostly flat frames and frames drawn from a small palette are graphics,
+// or screenshots when text adds dense sharp edges
+inline ContentClass classify(const ImageAnalysis& analysis, int channels) {
+    const uint32_t palette = channels >= 3 ? kPaletteColors : kPaletteGreys;
+    if (analysis.flatBlockFraction <= 0.5 && analysis.uniqueColors > palette) return ContentClass::Photo;
+    return analysis.edgeDensity > kTextEdges ? ContentClass::Screenshot : ContentClass::Graphic;
+}
+
+inline ImageAnalysis finish(const BandStats& total, const ColorSet& colors, int width, int height, int channels) {
+    ImageAnalysis analysis;
+    const double pixels = static_cast<double>(width) * height;
+    double entropy = 0.0;
+    for (int i = 0; i < 256; i++) {
+        analysis.histogram[i] = total.histogram[i];
+        if (total.histogram[i] == 0) continue;
+        const double p = total.histogram[i] / pixels;
+        entropy -= p * std::log2(p);
+    }
+    analysis.lumaEntropy = entropy;
+    analysis.uniqueColors = colors.count();
+    analysis.hasAlpha = total.transparent + total.translucent > 0;
+    analysis.transparentFraction = total.transparent / pixels;
+    analysis.translucentFraction = total.translucent / pixels;
+    analysis.edgeDensity = total.edges / pixels;
+    analysis.meanBlockVariance = total.blocks ? total.varianceSum / total.blocks : 0.0;
+    analysis.flatBlockFraction = total.blocks ? static_cast<double>(total.flatBlocks) / total.blocks : 0.0;
+    analysis.contentClass = classify(analysis, channels);
+    return analysis;
+}
+
+} // namespace analyzer
@@ -0,0 +1,161 @@
+// AV1 still-image (AVIF) encoding through libavif
+//
+// libavif is optional: builds define IMAGE_PROCESSOR_HAS_AVIF when it (and an
+// AV1 encoder such as libaom or rav1e) is linked in. Without it encode()
+// and decode() fail and kAvailable is false, so callers can steer clients
+// to another format instead of shipping bytes no browser can decode.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(IMAGE_PROCESSOR_HAS_AVIF)
+#include <avif/avif.h>
+#endif
+
+namespace avif {
+
+#if defined(IMAGE_PROCESSOR_HAS_AVIF)
+constexpr bool kAvailable = true;
+#else
+constexpr bool kAvailable = false;
+#endif
+
+constexpr int kSlowestSpeed = 0;
+constexpr int kFastestSpeed = 10;
+
+struct EncodeSettings {
+    int quality = 60;       // 0-100; 100 selects lossless
+    int speed = 6;          // 0 (best compression) - 10 (fastest)
+    int tileRowsLog2 = -1;  // -1 lets the encoder pick tiles from the size
+    int tileColsLog2 = -1;
+    int threads = 1;        // Tiles are encoded concurrently up to this
+};
+
+// Rough libaom ns/pixel for each preset, fastest (speed 10) first, as
+// priors for EncodeCostModel; level = kFastestSpeed - speed
+constexpr double kCostPriors[kFastestSpeed + 1] = {
+    25, 40, 70, 120, 200, 400, 800, 1500, 3000, 8000, 20000,
+};
+
+#if defined(IMAGE_PROCESSOR_HAS_AVIF)
+
+// Encode interleaved 8-bit pixels (1-4 channels, rows `stride` bytes apart)
+inline bool encode(const uint8_t* pixels, int width, int height, int channels, size_t stride,
+                   const EncodeSettings& settings, std::vector<uint8_t>& out) {
+    out.clear();
+    if (pixels == nullptr || width <= 0 || height <= 0 || channels < 1 || channels > 4) return false;
+
+    const bool lossless = settings.quality >= 100;
+    const bool grey = channels <= 2;
+    const bool alpha = channels == 2 || channels == 4;
+
+    avifPixelFormat format = AVIF_PIXEL_FORMAT_YUV420;
+    if (grey) {
+        format = AVIF_PIXEL_FORMAT_YUV400;
+    } else if (lossless) {
+        format = AVIF_PIXEL_FORMAT_YUV444;
+    }
+
+    avifImage* image = avifImageCreate(width, height, 8, format);
+    if (image == nullptr) return false;
+    image->yuvRange = AVIF_RANGE_FULL;
+    if (lossless && !grey) {
+        // Lossless RGB must skip the YUV transform (AV1 forbids identity
+        // coefficients with subsampled or monochrome frames)
+        image->matrixCoefficients = AVIF_MATRIX_COEFFICIENTS_IDENTITY;
+    }
+
+    avifResult result = AVIF_RESULT_OK;
+    if (grey) {
+        // Grey maps straight onto the luma plane; no colour conversion
+        const avifPlanesFlags planes = alpha ? AVIF_PLANES_YUV | AVIF_PLANES_A : AVIF_PLANES_YUV;
+        result = avifImageAllocatePlanes(image, planes);
+        for (int y = 0; result == AVIF_RESULT_OK && y < height; y++) {
+            const uint8_t* src = pixels + y * stride;
+            uint8_t* luma = image->yuvPlanes[AVIF_CHAN_Y] + static_cast<size_t>(y) * image->yuvRowBytes[AVIF_CHAN_Y];
+            uint8_t* a = alpha ? image->alphaPlane + static_cast<size_t>(y) * image->alphaRowBytes : nullptr;
+            for (int x = 0; x < width; x++) {
+                luma[x] = src[x * channels];
+                if (a) a[x] = src[x * channels + 1];
+            }
+        }
+    } else {
+        avifRGBImage rgb;
+        avifRGBImageSetDefaults(&rgb, image);
+        rgb.format = alpha ? AVIF_RGB_FORMAT_RGBA : AVIF_RGB_FORMAT_RGB;
+        rgb.depth = 8;
+        rgb.pixels = const_cast<uint8_t*>(pixels);
+        rgb.rowBytes = static_cast<uint32_t>(stride);
+        result = avifImageRGBToYUV(image, &rgb);
+    }
+
+    avifEncoder* encoder = result == AVIF_RESULT_OK ? avifEncoderCreate() : nullptr;
+    if (encoder == nullptr) {
+        avifImageDestroy(image);
+        return false;
+    }
+
+    encoder->speed = std::clamp(settings.speed, kSlowestSpeed, kFastestSpeed);
+    encoder->maxThreads = std::max(settings.threads, 1);
+    encoder->quality = lossless ? AVIF_QUALITY_LOSSLESS : std::clamp(settings.quality, 0, 100);
+    encoder->qualityAlpha = lossless ? AVIF_QUALITY_LOSSLESS : encoder->quality;
+    if (settings.tileRowsLog2 < 0 || settings.tileColsLog2 < 0) {
+        encoder->autoTiling = AVIF_TRUE;
+    } else {
+        encoder->tileRowsLog2 = std::min(settings.tileRowsLog2, 6);
+        encoder->tileColsLog2 = std::min(settings.tileColsLog2, 6);
+    }
+
+    avifRWData output = AVIF_DATA_EMPTY;
+    result = avifEncoderWrite(encoder, image, &output);
+    if (result == AVIF_RESULT_OK) {
+        out.assign(output.data, output.data + output.size);
+    }
+
+    avifRWDataFree(&output);
+    avifEncoderDestroy(encoder);
+    avifImageDestroy(image);
+    return result == AVIF_RESULT_OK;
+}
+
+// Decode an encoded frame of exactly width x height into RGBA rows
+// `stride` bytes apart, e.g. to measure what an encode preserved
+inline bool decode(const uint8_t* data, size_t size, int width, int height, uint8_t* rgba, size_t stride) {
+    avifDecoder* decoder = avifDecoderCreate();
+    avifImage* image = avifImageCreateEmpty();
+    bool ok = decoder != nullptr && image != nullptr &&
+              avifDecoderReadMemory(decoder, image, data, size) == AVIF_RESULT_OK &&
+              static_cast<int>(image->width) == width && static_cast<int>(image->height) == height;
+
+    if (ok) {
+        avifRGBImage rgb;
+        avifRGBImageSetDefaults(&rgb, image);
+        rgb.format = AVIF_RGB_FORMAT_RGBA;
+        rgb.depth = 8;
+        rgb.pixels = rgba;
+        rgb.rowBytes = static_cast<uint32_t>(stride);
+        ok = avifImageYUVToRGB(image, &rgb) == AVIF_RESULT_OK;
+    }
+
+    if (image != nullptr) avifImageDestroy(image);
+    if (decoder != nullptr) avifDecoderDestroy(decoder);
+    return ok;
+}
+
+#else
+
+inline bool encode(const uint8_t*, int, int, int, size_t, const EncodeSettings&, std::vector<uint8_t>& out) {
+    out.clear();
+    return false;
+}
+
+inline bool decode(const uint8_t*, size_t, int, int, uint8_t*, size_t) {
+    return false;
+}
+
+#endif
+
+} // namespace avif
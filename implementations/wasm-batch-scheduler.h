@@ -0,0 +1,323 @@
+// Batch scheduler: many images through a pool of isolated processors
+//
+// Every worker thread owns its own ImageProcessor, so concurrent jobs never
+// share source pointers, scratch buffers or output buffers. Jobs wait in
+// per-worker deques, one per priority lane. A worker takes from its own
+// deques first and steals from the back of the other workers' deques, and
+// it always checks the more urgent lanes first. Results are queued as jobs
+// finish, so the caller can hand each image to the page as soon as it is
+// ready rather than when the whole batch is done.
+//
+// Builds without threads have one worker and no threads; queued jobs then
+// run one at a time inside nextResult(), which still returns them in lane
+// order.
+#pragma once
+
+#include "wasm-image-processor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class BatchScheduler {
+public:
+    // Lane 0 is for on-screen images, 1 for images near the viewport and
+    // 2 for everything else
+    static constexpr int kLanes = 3;
+
+    // Jobs take their settings from `owner` when they are queued, and the
+    // workers share owner's encode cache. threads <= 0 starts one worker
+    // per hardware thread.
+    BatchScheduler(ImageProcessor& owner, int threads) : owner(owner) {
+#if IMAGE_THREADS_AVAILABLE
+        const int count = threads > 0 ? threads
+                                      : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+#else
+        const int count = 1;
+#endif
+        for (int i = 0; i < count; i++) {
+            auto worker = std::make_unique<Worker>();
+            worker->processor.shareEncodeCache(owner);
+            worker->processor.setThreading(false, 1);  // Parallel across jobs, not within
+            workers.push_back(std::move(worker));
+        }
+#if IMAGE_THREADS_AVAILABLE
+        for (int i = 0; i < count; i++) {
+            workers[i]->thread = std::thread([this, i] { workerLoop(i); });
+        }
+#endif
+    }
+
+    ~BatchScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            if (worker->thread.joinable()) worker->thread.join();
+        }
+    }
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    int workerCount() const {
+        return static_cast<int>(workers.size());
+    }
+
+    // Queue one image through `pipeline`. The pixels are borrowed like
+    // loadImageView and must stay valid until the job has finished.
+    // Returns the job id, or -1 if the image is invalid.
+    int submit(uintptr_t dataPtr, size_t size, int w, int h, int c, const ImagePipeline& pipeline, int lane) {
+        const size_t bytes = frameBytes(w, h, c);
+        if (dataPtr == 0 || bytes == 0 || size < bytes) {
+            return -1;
+        }
+
+        auto job = std::make_unique<Job>();
+        job->pixels = dataPtr;
+        job->size = size;
+        job->width = w;
+        job->height = h;
+        job->channels = c;
+        job->pipeline = pipeline;
+        job->settings = owner.getSettings();
+        job->lane = std::clamp(lane, 0, kLanes - 1);
+        const int jobLane = job->lane;
+
+        // Spread submissions across workers; stealing evens out the rest
+        int id;
+        Worker* worker;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            id = static_cast<int>(jobs.size());
+            jobs.push_back(std::move(job));
+            worker = workers[nextWorker++ % workers.size()].get();
+        }
+
+        // Count the job while its deque is still locked, in takeJob's lock
+        // order, so `queued` always equals the ids in the deques: it never
+        // goes negative, and a woken worker finds nothing only when another
+        // worker took the job first
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->lanes[jobLane].push_back(id);
+            std::lock_guard<std::mutex> jobsLock(mutex);
+            queued++;
+        }
+        wake.notify_one();
+        return id;
+    }
+
+    // Move a job that has not started yet to another lane, e.g. when it
+    // scrolls into view. Returns false once the job has been picked up.
+    bool setJobLane(int id, int lane) {
+        lane = std::clamp(lane, 0, kLanes - 1);
+        for (auto& worker : workers) {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            for (auto& queue : worker->lanes) {
+                auto it = std::find(queue.begin(), queue.end(), id);
+                if (it == queue.end()) continue;
+                queue.erase(it);
+                worker->lanes[lane].push_back(id);
+                std::lock_guard<std::mutex> jobsLock(mutex);
+                jobs[id]->lane = lane;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Id of the next finished job not yet returned, or -1 if none is ready.
+    // Never blocks, so it is safe on the browser main thread.
+    int nextResult() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!finished.empty()) return popFinished();
+        }
+#if !IMAGE_THREADS_AVAILABLE
+        const int id = takeJob(0);
+        if (id >= 0) runJob(*workers[0], id);
+#endif
+        std::lock_guard<std::mutex> lock(mutex);
+        return finished.empty() ? -1 : popFinished();
+    }
+
+    // Like nextResult, but waits up to timeoutMs for a job to finish. Do not
+    // call this on the browser main thread.
+    int waitResult(int timeoutMs) {
+#if IMAGE_THREADS_AVAILABLE
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait_for(lock, std::chrono::milliseconds(std::max(timeoutMs, 0)),
+                           [this] { return !finished.empty() || running + queued == 0; });
+        return finished.empty() ? -1 : popFinished();
+#else
+        (void)timeoutMs;
+        return nextResult();
+#endif
+    }
+
+    // Jobs queued or running
+    int pendingCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued + running;
+    }
+
+    bool resultOk(int id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return validId(id) && jobs[id]->state == JobState::Finished && jobs[id]->ok;
+    }
+
+    // Encoded bytes of a finished job; valid until releaseResult(id)
+    emscripten::val resultView(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!validId(id) || jobs[id]->state != JobState::Finished) {
+            return emscripten::val(emscripten::typed_memory_view(0, static_cast<const uint8_t*>(nullptr)));
+        }
+        const std::vector<uint8_t>& output = jobs[id]->output;
+        return emscripten::val(emscripten::typed_memory_view(output.size(), output.data()));
+    }
+
+    // Move a finished job's bytes out, for native callers. Frees the job
+    // like releaseResult.
+    std::vector<uint8_t> takeResult(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!validId(id) || jobs[id]->state != JobState::Finished) return {};
+        std::vector<uint8_t> output = std::move(jobs[id]->output);
+        jobs[id].reset();
+        return output;
+    }
+
+    // Free a finished job, output, pipeline and settings included, once the
+    // caller has copied its bytes. The id is invalid afterwards.
+    void releaseResult(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!validId(id) || jobs[id]->state != JobState::Finished) return;
+        jobs[id].reset();
+    }
+
+private:
+    enum class JobState { Queued, Running, Finished };
+
+    struct Job {
+        uintptr_t pixels = 0;
+        size_t size = 0;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        ImagePipeline pipeline;
+        ProcessorSettings settings;
+        int lane = 0;
+        JobState state = JobState::Queued;
+        bool ok = false;
+        std::vector<uint8_t> output;
+    };
+
+    struct Worker {
+        ImageProcessor processor;
+        std::mutex mutex;  // Guards lanes
+        std::deque<int> lanes[kLanes];
+        std::thread thread;
+    };
+
+    // Released jobs leave an empty slot; ids are not reused, so a stale id
+    // can never name a newer job
+    bool validId(int id) const {
+        return id >= 0 && id < static_cast<int>(jobs.size()) && jobs[id] != nullptr;
+    }
+
+    int popFinished() {
+        const int id = finished.front();
+        finished.pop_front();
+        return id;
+    }
+
+    // Most urgent queued job: own deque from the front, then the other
+    // workers' deques from the back, lane by lane. -1 if nothing is queued.
+    int takeJob(int self) {
+        const int count = static_cast<int>(workers.size());
+        for (int lane = 0; lane < kLanes; lane++) {
+            for (int i = 0; i < count; i++) {
+                Worker& victim = *workers[(self + i) % count];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                std::deque<int>& queue = victim.lanes[lane];
+                if (queue.empty()) continue;
+
+                int id;
+                if (i == 0) {
+                    id = queue.front();
+                    queue.pop_front();
+                } else {
+                    id = queue.back();
+                    queue.pop_back();
+                }
+
+                std::lock_guard<std::mutex> jobsLock(mutex);
+                queued--;
+                running++;
+                jobs[id]->state = JobState::Running;
+                return id;
+            }
+        }
+        return -1;
+    }
+
+    void runJob(Worker& worker, int id) {
+        Job* job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = jobs[id].get();
+        }
+
+        ImageProcessor& processor = worker.processor;
+        processor.applySettings(job->settings);
+        std::vector<uint8_t> output;
+        bool ok = processor.loadImageView(job->pixels, job->size, job->width, job->height, job->channels);
+        if (ok) {
+            output = processor.runPipeline(job->pipeline);
+            ok = !output.empty();
+        }
+        processor.releaseBuffers();  // Drop the borrowed pointer
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->output = std::move(output);
+            job->ok = ok;
+            job->state = JobState::Finished;
+            running--;
+            finished.push_back(id);
+        }
+        completed.notify_all();
+    }
+
+    void workerLoop(int self) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || queued > 0; });
+                if (stopping) return;
+            }
+
+            // Another worker may have taken the job first; then just wait again
+            const int id = takeJob(self);
+            if (id >= 0) runJob(*workers[self], id);
+        }
+    }
+
+    ImageProcessor& owner;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Guards jobs, finished, the counters and nextWorker
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable completed;
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::deque<int> finished;
+    int queued = 0;
+    int running = 0;
+    size_t nextWorker = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,337 @@
+// Factorized DCT-II / DCT-III for 4, 8, 16 and 32 point blocks
+//
+// All transforms are orthonormal and separable. Coefficient tables are
+// generated at compile time; blocks are transformed in place in caller
+// owned fixed-size buffers.
+//   - 8 point: Arai-Agui-Nakajima butterflies with folded output scaling
+//   - 2^k points: even half recursed as an N/2 transform, odd half as an
+//     N/2 x N/2 product against the odd table rows
+//   - fixed point: integer even/odd butterflies with Q12 tables
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "wasm-simd.h"
+
+namespace dct {
+
+constexpr int kMaxSize = 32;
+constexpr int kFixedBits = 12;     // Table precision
+constexpr int kFixedFraction = 4;  // Fraction bits carried between passes
+
+// ---------------------------------------------------------------------------
+// Compile-time tables
+// ---------------------------------------------------------------------------
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double constexprCos(double x) {
+    // Reduce to [-pi, pi], then Taylor series
+    while (x > kPi) x -= 2 * kPi;
+    while (x < -kPi) x += 2 * kPi;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int i = 1; i < 30; i++) {
+        term *= -x * x / ((2 * i - 1) * (2 * i));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprSqrt(double x) {
+    double r = x > 1 ? x : 1.0;
+    for (int i = 0; i < 64; i++) r = 0.5 * (r + x / r);
+    return r;
+}
+
+constexpr double kInvSqrt2 = 0.70710678118654752440;
+
+// Orthonormal basis: T[k][n] = sqrt(2/N) * c(k) * cos((2n + 1) k pi / 2N)
+constexpr double basis(int n, int k, int size) {
+    const double ck = k == 0 ? kInvSqrt2 : 1.0;
+    return constexprSqrt(2.0 / size) * ck * constexprCos((2 * n + 1) * k * kPi / (2 * size));
+}
+
+template <int N>
+struct Tables {
+    std::array<float, N * N> basis{};    // [k * N + n]
+    std::array<int32_t, N * N> fixed{};  // basis in Q(kFixedBits)
+};
+
+template <int N>
+constexpr Tables<N> makeTables() {
+    Tables<N> t;
+    for (int k = 0; k < N; k++) {
+        for (int n = 0; n < N; n++) {
+            const double v = dct::basis(n, k, N);
+            t.basis[k * N + n] = static_cast<float>(v);
+            const double q = v * (1 << kFixedBits);
+            t.fixed[k * N + n] = static_cast<int32_t>(q < 0 ? q - 0.5 : q + 0.5);
+        }
+    }
+    return t;
+}
+
+template <int N>
+constexpr Tables<N> kTables = makeTables<N>();
+
+// AAN output k is the orthonormal coefficient times sqrt(8) * a(k), with
+// a(0) = 1 and a(k) = sqrt(2) * cos(k pi / 16)
+constexpr double aanScale(int k) {
+    return k == 0 ? 1.0 : constexprSqrt(2.0) * constexprCos(k * kPi / 16);
+}
+
+struct AANScales {
+    std::array<float, 8> forward{};  // Multiply AAN outputs
+    std::array<float, 8> inverse{};  // Multiply inputs before the AAN IDCT
+};
+
+constexpr AANScales makeAANScales() {
+    AANScales s;
+    for (int k = 0; k < 8; k++) {
+        s.forward[k] = static_cast<float>(1.0 / (aanScale(k) * constexprSqrt(8.0)));
+        s.inverse[k] = static_cast<float>(aanScale(k) / constexprSqrt(8.0));
+    }
+    return s;
+}
+
+constexpr AANScales kAAN = makeAANScales();
+
+// ---------------------------------------------------------------------------
+// 1D float transforms, templated on float or simd::F32x4 lanes
+// ---------------------------------------------------------------------------
+template <typename T>
+inline void aanForward8(T* x) {
+    T tmp0 = x[0] + x[7], tmp7 = x[0] - x[7];
+    T tmp1 = x[1] + x[6], tmp6 = x[1] - x[6];
+    T tmp2 = x[2] + x[5], tmp5 = x[2] - x[5];
+    T tmp3 = x[3] + x[4], tmp4 = x[3] - x[4];
+
+    // Even part
+    T tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+    T tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+    T z1 = (tmp12 + tmp13) * 0.707106781f;
+    x[0] = (tmp10 + tmp11) * kAAN.forward[0];
+    x[4] = (tmp10 - tmp11) * kAAN.forward[4];
+    x[2] = (tmp13 + z1) * kAAN.forward[2];
+    x[6] = (tmp13 - z1) * kAAN.forward[6];
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    T z5 = (tmp10 - tmp12) * 0.382683433f;
+    T z2 = tmp10 * 0.541196100f + z5;
+    T z4 = tmp12 * 1.306562965f + z5;
+    T z3 = tmp11 * 0.707106781f;
+    T z11 = tmp7 + z3, z13 = tmp7 - z3;
+    x[5] = (z13 + z2) * kAAN.forward[5];
+    x[3] = (z13 - z2) * kAAN.forward[3];
+    x[1] = (z11 + z4) * kAAN.forward[1];
+    x[7] = (z11 - z4) * kAAN.forward[7];
+}
+
+template <typename T>
+inline void aanInverse8(T* x) {
+    // Even part
+    T tmp0 = x[0] * kAAN.inverse[0], tmp1 = x[2] * kAAN.inverse[2];
+    T tmp2 = x[4] * kAAN.inverse[4], tmp3 = x[6] * kAAN.inverse[6];
+    T tmp10 = tmp0 + tmp2, tmp11 = tmp0 - tmp2;
+    T tmp13 = tmp1 + tmp3;
+    T tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    T tmp4 = x[1] * kAAN.inverse[1], tmp5 = x[3] * kAAN.inverse[3];
+    T tmp6 = x[5] * kAAN.inverse[5], tmp7 = x[7] * kAAN.inverse[7];
+    T z13 = tmp6 + tmp5, z10 = tmp6 - tmp5;
+    T z11 = tmp4 + tmp7, z12 = tmp4 - tmp7;
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562f;
+    T z5 = (z10 + z12) * 1.847759065f;
+    tmp10 = z12 * 1.082392200f - z5;
+    tmp12 = z10 * -2.613125930f + z5;
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    x[0] = tmp0 + tmp7;
+    x[7] = tmp0 - tmp7;
+    x[1] = tmp1 + tmp6;
+    x[6] = tmp1 - tmp6;
+    x[2] = tmp2 + tmp5;
+    x[5] = tmp2 - tmp5;
+    x[4] = tmp3 + tmp4;
+    x[3] = tmp3 - tmp4;
+}
+
+template <int N, typename T>
+inline void forward1D(T* x) {
+    if constexpr (N == 8) {
+        aanForward8(x);
+    } else if constexpr (N == 2) {
+        T s = x[0] + x[1], d = x[0] - x[1];
+        x[0] = s * static_cast<float>(kInvSqrt2);
+        x[1] = d * static_cast<float>(kInvSqrt2);
+    } else {
+        constexpr int H = N / 2;
+        const auto& t = kTables<N>.basis;
+        T even[H], odd[H];
+        for (int n = 0; n < H; n++) {
+            even[n] = x[n] + x[N - 1 - n];
+            odd[n] = x[n] - x[N - 1 - n];
+        }
+
+        // X[2m] = DCT_{N/2}(even)[m] / sqrt(2)
+        forward1D<H>(even);
+        for (int m = 0; m < H; m++) {
+            x[2 * m] = even[m] * static_cast<float>(kInvSqrt2);
+        }
+
+        for (int k = 1; k < N; k += 2) {
+            T sum = odd[0] * t[k * N];
+            for (int n = 1; n < H; n++) {
+                sum = sum + odd[n] * t[k * N + n];
+            }
+            x[k] = sum;
+        }
+    }
+}
+
+template <int N, typename T>
+inline void inverse1D(T* x) {
+    if constexpr (N == 8) {
+        aanInverse8(x);
+    } else if constexpr (N == 2) {
+        T s = x[0] + x[1], d = x[0] - x[1];
+        x[0] = s * static_cast<float>(kInvSqrt2);
+        x[1] = d * static_cast<float>(kInvSqrt2);
+    } else {
+        constexpr int H = N / 2;
+        const auto& t = kTables<N>.basis;
+        T even[H], odd[H];
+        for (int m = 0; m < H; m++) {
+            even[m] = x[2 * m];
+        }
+        inverse1D<H>(even);
+
+        for (int n = 0; n < H; n++) {
+            T sum = x[1] * t[N + n];
+            for (int k = 3; k < N; k += 2) {
+                sum = sum + x[k] * t[k * N + n];
+            }
+            odd[n] = sum;
+        }
+
+        for (int n = 0; n < H; n++) {
+            T e = even[n] * static_cast<float>(kInvSqrt2);
+            x[n] = e + odd[n];
+            x[N - 1 - n] = e - odd[n];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 2D float transforms: columns, transpose, columns, transpose
+// ---------------------------------------------------------------------------
+template <int N>
+inline void transpose(float* block) {
+    for (int i = 0; i < N; i++) {
+        for (int j = i + 1; j < N; j++) {
+            float t = block[i * N + j];
+            block[i * N + j] = block[j * N + i];
+            block[j * N + i] = t;
+        }
+    }
+}
+
+template <int N, bool Inverse>
+inline void transformColumns(float* block, bool vectorize) {
+    int j = 0;
+    if (vectorize && simd::kAvailable) {
+        // Four adjacent columns per vector
+        for (; j + 4 <= N; j += 4) {
+            simd::F32x4 v[N];
+            for (int k = 0; k < N; k++) v[k] = simd::load4(block + k * N + j);
+            if constexpr (Inverse) inverse1D<N>(v); else forward1D<N>(v);
+            for (int k = 0; k < N; k++) simd::store4(block + k * N + j, v[k]);
+        }
+    }
+    for (; j < N; j++) {
+        float v[N];
+        for (int k = 0; k < N; k++) v[k] = block[k * N + j];
+        if constexpr (Inverse) inverse1D<N>(v); else forward1D<N>(v);
+        for (int k = 0; k < N; k++) block[k * N + j] = v[k];
+    }
+}
+
+template <int N, bool Inverse>
+inline void transform2D(float* block, bool vectorize) {
+    transformColumns<N, Inverse>(block, vectorize);
+    transpose<N>(block);
+    transformColumns<N, Inverse>(block, vectorize);
+    transpose<N>(block);
+}
+
+// ---------------------------------------------------------------------------
+// 2D fixed-point transforms. Forward takes integer samples and returns
+// coefficients; inverse returns integer samples. Both carry kFixedFraction
+// bits between the passes and accumulate in 64 bits.
+// ---------------------------------------------------------------------------
+template <int N, bool Inverse>
+inline void fixed1D(const int32_t* in, int inStride, int32_t* out, int outStride, int shift) {
+    constexpr int H = N / 2;
+    const auto& t = kTables<N>.fixed;
+    const int64_t round = shift > 0 ? int64_t(1) << (shift - 1) : 0;
+
+    if constexpr (!Inverse) {
+        int64_t even[H], odd[H];
+        for (int n = 0; n < H; n++) {
+            even[n] = int64_t(in[n * inStride]) + in[(N - 1 - n) * inStride];
+            odd[n] = int64_t(in[n * inStride]) - in[(N - 1 - n) * inStride];
+        }
+        for (int k = 0; k < N; k++) {
+            const int64_t* src = (k & 1) ? odd : even;
+            int64_t sum = 0;
+            for (int n = 0; n < H; n++) sum += src[n] * t[k * N + n];
+            out[k * outStride] = static_cast<int32_t>((sum + round) >> shift);
+        }
+    } else {
+        for (int n = 0; n < H; n++) {
+            int64_t even = 0, odd = 0;
+            for (int k = 0; k < N; k += 2) even += int64_t(in[k * inStride]) * t[k * N + n];
+            for (int k = 1; k < N; k += 2) odd += int64_t(in[k * inStride]) * t[k * N + n];
+            out[n * outStride] = static_cast<int32_t>((even + odd + round) >> shift);
+            out[(N - 1 - n) * outStride] = static_cast<int32_t>((even - odd + round) >> shift);
+        }
+    }
+}
+
+// Samples in, coefficients scaled by 2^kFixedFraction out
+template <int N>
+inline void forwardFixed2D(const int32_t* samples, int32_t* coefficients) {
+    int32_t temp[N * N];
+    for (int j = 0; j < N; j++) {
+        fixed1D<N, false>(samples + j, N, temp + j, N, kFixedBits - kFixedFraction);
+    }
+    for (int i = 0; i < N; i++) {
+        fixed1D<N, false>(temp + i * N, 1, coefficients + i * N, 1, kFixedBits);
+    }
+}
+
+// Coefficients scaled by 2^kFixedFraction in, samples out
+template <int N>
+inline void inverseFixed2D(const int32_t* coefficients, int32_t* samples) {
+    int32_t temp[N * N];
+    for (int j = 0; j < N; j++) {
+        fixed1D<N, true>(coefficients + j, N, temp + j, N, kFixedBits);
+    }
+    for (int i = 0; i < N; i++) {
+        fixed1D<N, true>(temp + i * N, 1, samples + i * N, 1, kFixedBits + kFixedFraction);
+    }
+}
+
+} // namespace dct
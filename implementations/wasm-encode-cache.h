@@ -0,0 +1,179 @@
+// Content-addressed cache of encoded results
+//
+// Keys combine a hash of the source pixels with every parameter that
+// shapes the output; values are the encoded bytes. Entries are evicted
+// least-recently-used first once their total size passes the byte limit.
+// The whole cache can be exported as one blob (the loader keeps it in
+// IndexedDB) and imported again in a later session. All methods are
+// thread-safe, so batch workers can share one cache.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct EncodeCacheStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    uint32_t entries = 0;
+    double bytes = 0;  // double so embind hands JS a plain number
+};
+
+class EncodeCache {
+public:
+    // Rough per-entry bookkeeping cost charged against the limit
+    static constexpr size_t kEntryOverhead = 96;
+
+    void setLimit(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit = bytes;
+        trim();
+    }
+
+    size_t getLimit() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return limit;
+    }
+
+    // Copy the cached value for key into out; counts a hit or a miss
+    bool lookup(const std::string& key, std::vector<uint8_t>& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return false;
+        }
+
+        entries.splice(entries.begin(), entries, it->second);
+        out.assign(it->second->value.begin(), it->second->value.end());
+        hits++;
+        return true;
+    }
+
+    void insert(const std::string& key, const std::vector<uint8_t>& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        insertLocked(key, value);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        usedBytes = 0;
+    }
+
+    EncodeCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        EncodeCacheStats s;
+        s.hits = hits;
+        s.misses = misses;
+        s.evictions = evictions;
+        s.entries = static_cast<uint32_t>(entries.size());
+        s.bytes = static_cast<double>(usedBytes);
+        return s;
+    }
+
+    // "IPC1", entry count, then (key length, key, value length, value) from
+    // least to most recently used, all integers little-endian u32
+    void serialize(std::vector<uint8_t>& out) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.clear();
+        out.insert(out.end(), kMagic, kMagic + 4);
+        putU32(out, static_cast<uint32_t>(entries.size()));
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            putU32(out, static_cast<uint32_t>(it->key.size()));
+            out.insert(out.end(), it->key.begin(), it->key.end());
+            putU32(out, static_cast<uint32_t>(it->value.size()));
+            out.insert(out.end(), it->value.begin(), it->value.end());
+        }
+    }
+
+    // Merge entries from a serialize() blob; false if it is malformed
+    bool deserialize(const uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+        uint32_t count;
+        if (size < 8 || std::memcmp(p, kMagic, 4) != 0) return false;
+        p += 4;
+        if (!getU32(p, end, count)) return false;
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t keySize, valueSize;
+            if (!getU32(p, end, keySize) || static_cast<size_t>(end - p) < keySize) return false;
+            std::string key(reinterpret_cast<const char*>(p), keySize);
+            p += keySize;
+            if (!getU32(p, end, valueSize) || static_cast<size_t>(end - p) < valueSize) return false;
+            insertLocked(key, std::vector<uint8_t>(p, p + valueSize));
+            p += valueSize;
+        }
+        return true;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<uint8_t> value;
+    };
+
+    static constexpr char kMagic[4] = {'I', 'P', 'C', '1'};
+
+    static size_t entryCost(const Entry& entry) {
+        return entry.key.size() + entry.value.size() + kEntryOverhead;
+    }
+
+    void insertLocked(const std::string& key, const std::vector<uint8_t>& value) {
+        const size_t cost = key.size() + value.size() + kEntryOverhead;
+        if (cost > limit) return;
+
+        auto it = index.find(key);
+        if (it != index.end()) {
+            usedBytes -= entryCost(*it->second);
+            entries.erase(it->second);
+            index.erase(it);
+        }
+
+        entries.push_front({key, value});
+        index[key] = entries.begin();
+        usedBytes += cost;
+        trim();
+    }
+
+    void trim() {
+        while (usedBytes > limit && !entries.empty()) {
+            usedBytes -= entryCost(entries.back());
+            index.erase(entries.back().key);
+            entries.pop_back();
+            evictions++;
+        }
+    }
+
+    static void putU32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int b = 0; b < 4; b++) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * b)));
+        }
+    }
+
+    static bool getU32(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+        if (end - p < 4) return false;
+        value = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        p += 4;
+        return true;
+    }
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t limit = 0;
+    size_t usedBytes = 0;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+};
@@ -0,0 +1,72 @@
+// Running model of encoder cost, used to meet wall-clock budgets
+//
+// Encoders expose discrete effort levels (libwebp methods, AV1 speed
+// presets). The model keeps an exponential moving average of measured
+// ns/pixel per level and image size class, falling back to prior figures
+// scaled by what measurements so far say about this host.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+class EncodeCostModel {
+public:
+    static constexpr int kMaxLevels = 11;
+    static constexpr int kSizeClasses = 5;
+
+    // priors[level] is the expected ns/pixel, levels ordered from the
+    // cheapest to the most thorough
+    EncodeCostModel(const double* priors, int levelCount)
+        : levels(std::clamp(levelCount, 1, kMaxLevels)) {
+        std::copy(priors, priors + levels, prior);
+    }
+
+    int levelCount() const {
+        return levels;
+    }
+
+    // Up to 64^2, 256^2, 1024^2, 2048^2 and beyond: small images carry
+    // fixed costs that make their per-pixel figures much higher
+    static int sizeClass(size_t pixelCount) {
+        if (pixelCount <= 64 * 64) return 0;
+        if (pixelCount <= 256 * 256) return 1;
+        if (pixelCount <= 1024 * 1024) return 2;
+        if (pixelCount <= 2048 * 2048) return 3;
+        return 4;
+    }
+
+    double predictMs(int level, size_t pixelCount) const {
+        const double observed = measured[sizeClass(pixelCount)][level];
+        const double nsPerPixel = observed > 0 ? observed : prior[level] * correction;
+        return nsPerPixel * pixelCount * 1e-6;
+    }
+
+    // Most thorough level up to maxLevel predicted to finish within budgetMs.
+    // A budget <= 0 means unlimited; level 0 is the floor.
+    int choose(int maxLevel, size_t pixelCount, double budgetMs) const {
+        int level = std::clamp(maxLevel, 0, levels - 1);
+        if (budgetMs <= 0) return level;
+
+        for (; level > 0; level--) {
+            if (predictMs(level, pixelCount) <= budgetMs) break;
+        }
+        return level;
+    }
+
+    void record(int level, size_t pixelCount, double elapsedMs) {
+        if (level < 0 || level >= levels || pixelCount == 0 || elapsedMs <= 0) return;
+        const double nsPerPixel = elapsedMs * 1e6 / pixelCount;
+
+        double& observed = measured[sizeClass(pixelCount)][level];
+        observed = observed > 0 ? 0.75 * observed + 0.25 * nsPerPixel : nsPerPixel;
+
+        // Carries what one level taught us over to levels not yet measured
+        correction = 0.75 * correction + 0.25 * (nsPerPixel / prior[level]);
+    }
+
+private:
+    int levels;
+    double prior[kMaxLevels] = {};
+    double measured[kSizeClasses][kMaxLevels] = {};
+    double correction = 1.0;
+};
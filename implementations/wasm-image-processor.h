@@ -0,0 +1,3071 @@
+// High-Performance WebAssembly Image Processing Engine
+//
+// ImageProcessor and its supporting types. wasm-image-processor.cpp holds
+// the embind bindings; native builds compile the same code against the
+// stub emscripten headers in native/.
+#pragma once
+
+#include <emscripten.h>
+#include <emscripten/bind.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// WebP encoding; native builds without libwebp set IMAGE_PROCESSOR_HAS_WEBP=0
+#ifndef IMAGE_PROCESSOR_HAS_WEBP
+#define IMAGE_PROCESSOR_HAS_WEBP 1
+#endif
+
+#if IMAGE_PROCESSOR_HAS_WEBP
+extern "C" {
+#include "webp/encode.h"
+#include "webp/decode.h"
+}
+#else
+struct WebPPicture;
+#endif
+
+#include "wasm-analyzer.h"
+#include "wasm-avif.h"
+#include "wasm-dct.h"
+#include "wasm-encode-cache.h"
+#include "wasm-encode-cost.h"
+#include "wasm-planar.h"
+#include "wasm-profiler.h"
+#include "wasm-rans.h"
+#include "wasm-scratch-arena.h"
+#include "wasm-simd.h"
+#include "wasm-ssim.h"
+#include "wasm-thread-pool.h"
+
+// libwebp encode costs in ns/pixel for methods 0-6, used as priors
+constexpr double kWebPLossyCost[] = {12, 18, 25, 35, 50, 80, 180};
+constexpr double kWebPLosslessCost[] = {60, 80, 120, 200, 350, 600, 1500};
+constexpr double kWebPTargetedCost[] = {36, 54, 75, 105, 150, 240, 540};
+
+enum class DCTMode {
+    Float = 0,       // Factorized float transforms
+    FixedPoint = 1,  // Integer butterflies, Q12 tables
+};
+
+// Resampling filters, resolved from their API names once per call
+enum class ResizeFilter {
+    Lanczos,   // 3 lobes, separable
+    Bicubic,   // Catmull-Rom, separable
+    Bilinear,
+};
+
+enum class EncodeFormat { WebP, AVIF, JPEGXL, Raw };
+
+// Unknown names fall back to bilinear, as the string compares did
+inline ResizeFilter parseResizeFilter(const std::string& name) {
+    if (name == "lanczos") return ResizeFilter::Lanczos;
+    if (name == "bicubic") return ResizeFilter::Bicubic;
+    return ResizeFilter::Bilinear;
+}
+
+// Unknown names encode as WebP
+inline EncodeFormat parseEncodeFormat(const std::string& name) {
+    if (name == "avif") return EncodeFormat::AVIF;
+    if (name == "jpegxl") return EncodeFormat::JPEGXL;
+    if (name == "raw") return EncodeFormat::Raw;
+    return EncodeFormat::WebP;
+}
+
+inline const char* encodeFormatName(EncodeFormat format) {
+    switch (format) {
+        case EncodeFormat::AVIF: return "avif";
+        case EncodeFormat::JPEGXL: return "jpegxl";
+        case EncodeFormat::Raw: return "raw";
+        default: return "webp";
+    }
+}
+
+// Separable resampling coefficients for one axis. Built once per
+// (source size, destination size, filter) and shared by every row/column
+// and channel of the pass.
+struct ResampleWeights {
+    int srcSize = 0;
+    int dstSize = 0;
+    ResizeFilter filter = ResizeFilter::Lanczos;
+    int maxTaps = 0;             // Stride of the weights table
+    std::vector<int> start;      // First source sample for each output sample
+    std::vector<int> count;      // Taps used by each output sample
+    std::vector<float> weights;  // dstSize * maxTaps, each row sums to 1
+};
+
+// Borrowed, possibly strided view of interleaved 8-bit pixels
+struct ImageView {
+    const uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    size_t stride = 0;  // Bytes between rows
+    
+    const uint8_t* row(int y) const {
+        return data + static_cast<size_t>(y) * stride;
+    }
+};
+
+// Bytes of a tightly packed width x height frame with 1-4 channels, or 0
+// when the frame is empty or too large to address (over 4 GB on wasm32).
+// Products are taken in 64 bits so they cannot wrap first.
+inline size_t frameBytes(int width, int height, int channels) {
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4) return 0;
+    const uint64_t bytes = static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * channels;
+    return bytes <= SIZE_MAX ? static_cast<size_t>(bytes) : 0;
+}
+
+// Most recent rows of a source that arrives incrementally. Row y lives in
+// slot y % capacity, so at most `capacity` consecutive rows are addressable.
+struct RowRing {
+    std::vector<uint8_t> data;
+    int width = 0;
+    int height = 0;  // Height of the whole source, not of the ring
+    int channels = 0;
+    int capacity = 0;
+    size_t stride = 0;
+    
+    const uint8_t* row(int y) const {
+        return data.data() + static_cast<size_t>(y % capacity) * stride;
+    }
+    
+    uint8_t* row(int y) {
+        return data.data() + static_cast<size_t>(y % capacity) * stride;
+    }
+};
+
+// Summed-area tables of one channel over a tile of up to kSize x kSize
+// samples: any block inside the tile then sums in O(1). Entry (x, y) covers
+// [0, x) x [0, y). 32-bit entries are exact, since a whole tile of squares
+// is at most 1024 * 255^2.
+struct TileSums {
+    static constexpr int kSize = 32;
+    static constexpr int kPitch = kSize + 1;
+    uint32_t sum[kPitch * kPitch];
+    uint32_t sumSq[kPitch * kPitch];
+    int width = 0;
+    int height = 0;
+    
+    // w x h samples from `origin`, `step` bytes apart within a row
+    void build(const uint8_t* origin, size_t stride, int step, int w, int h) {
+        width = w;
+        height = h;
+        std::fill(sum, sum + kPitch, 0u);
+        std::fill(sumSq, sumSq + kPitch, 0u);
+        for (int y = 0; y < h; y++) {
+            const uint8_t* row = origin + static_cast<size_t>(y) * stride;
+            const uint32_t* above = sum + y * kPitch;
+            const uint32_t* aboveSq = sumSq + y * kPitch;
+            uint32_t* out = sum + (y + 1) * kPitch;
+            uint32_t* outSq = sumSq + (y + 1) * kPitch;
+            uint32_t rowSum = 0;
+            uint32_t rowSumSq = 0;
+            out[0] = 0;
+            outSq[0] = 0;
+            for (int x = 0; x < w; x++) {
+                const uint32_t v = row[x * step];
+                rowSum += v;
+                rowSumSq += v * v;
+                out[x + 1] = above[x + 1] + rowSum;
+                outSq[x + 1] = aboveSq[x + 1] + rowSumSq;
+            }
+        }
+    }
+    
+    // Population variance of the size x size block at (x, y) of the tile
+    float variance(int x, int y, int size) const {
+        const int a = y * kPitch + x;
+        const int b = a + size;
+        const int c = a + size * kPitch;
+        const int d = c + size;
+        const double count = static_cast<double>(size) * size;
+        const double mean = (sum[d] - sum[b] - sum[c] + sum[a]) / count;
+        const double meanSq = (sumSq[d] - sumSq[b] - sumSq[c] + sumSq[a]) / count;
+        return static_cast<float>(std::max(meanSq - mean * mean, 0.0));
+    }
+};
+
+// Declarative processing chain run by ImageProcessor::runPipeline.
+// Stages: optional crop, optional resize, any number of colour conversions
+// and a final encode. Without an encode stage the result is raw pixels.
+class ImagePipeline {
+public:
+    enum class StageType { Crop, Resize, ConvertColor, Encode };
+    
+    struct Stage {
+        StageType type = StageType::Crop;
+        int x = 0, y = 0;
+        int width = 0, height = 0;
+        int channels = 0;
+        int quality = 0;
+        bool lossless = false;
+        std::string name;  // Resize algorithm or encode format
+    };
+    
+    void crop(int x, int y, int w, int h) {
+        Stage stage;
+        stage.type = StageType::Crop;
+        stage.x = x;
+        stage.y = y;
+        stage.width = w;
+        stage.height = h;
+        stages.push_back(stage);
+    }
+    
+    void resize(int w, int h, const std::string& algorithm) {
+        Stage stage;
+        stage.type = StageType::Resize;
+        stage.width = w;
+        stage.height = h;
+        stage.name = algorithm;
+        stages.push_back(stage);
+    }
+    
+    // 1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA
+    void convertColor(int targetChannels) {
+        Stage stage;
+        stage.type = StageType::ConvertColor;
+        stage.channels = targetChannels;
+        stages.push_back(stage);
+    }
+    
+    // "webp", "avif", "jpegxl" or "raw"
+    void encode(const std::string& format, int quality, bool lossless) {
+        Stage stage;
+        stage.type = StageType::Encode;
+        stage.name = format;
+        stage.quality = quality;
+        stage.lossless = lossless;
+        stages.push_back(stage);
+    }
+    
+    void clear() {
+        stages.clear();
+    }
+    
+    const std::vector<Stage>& getStages() const {
+        return stages;
+    }
+    
+private:
+    std::vector<Stage> stages;
+};
+
+// Crop and scale applied by libwebp while decoding (see loadWebP). The crop
+// rectangle is in file pixels; a zero cropWidth or cropHeight extends it to
+// the right or bottom edge. The cropped area is then scaled to width x
+// height: a zero side keeps the aspect ratio, both zero keep the crop size.
+struct WebPDecodeOptions {
+    int cropX = 0;
+    int cropY = 0;
+    int cropWidth = 0;
+    int cropHeight = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Outcome of the last SSIM-targeted quality search (see setSSIMTarget)
+struct QualitySearchStats {
+    int quality = 0;  // Quality of the encode returned
+    float ssim = 0;   // Its MS-SSIM against the source
+    int encodes = 0;  // Trial encodes run
+};
+
+// Encoder and kernel options of one ImageProcessor, copied onto batch
+// workers so every job runs with the settings in force when it was queued
+struct ProcessorSettings {
+    bool useSimd = true;
+    DCTMode dctMode = DCTMode::Float;
+    double webpBudgetMs = 0;
+    int webpTargetSize = 0;
+    float webpTargetPSNR = 0;
+    bool webpSharpYUV = false;
+    avif::EncodeSettings avifSettings;
+    double avifBudgetMs = 0;
+    float ssimTarget = 0;
+    bool useEncodeCache = true;
+};
+
+class ImageProcessor {
+    // The native tests (tests/) reach internals through this
+    friend struct ImageProcessorTestAccess;
+    
+private:
+    std::vector<uint8_t> imageData;      // Owned copy made by loadImage
+    const uint8_t* pixels = nullptr;     // Current source: imageData or a borrowed buffer
+    size_t pixelBytes = 0;
+    int width, height, channels;
+    
+    // Backing store for the *View results, reused across calls
+    std::vector<uint8_t> outputBuffer;
+    
+    // Performance optimization flags
+    bool useSimd = true;
+    bool useMultithread = true;
+    int numThreads = 4;
+    
+    static constexpr int kMaxChannels = 4;
+    
+    // Resampling coefficient tables, reused across resize calls. Callers
+    // hold their own reference, so eviction never frees a table in use.
+    static constexpr size_t kMaxCachedWeights = 8;
+    std::vector<std::shared_ptr<const ResampleWeights>> weightCache;
+    DCTMode dctMode = DCTMode::Float;
+    
+    // Created on first parallel call with numThreads participants
+    std::unique_ptr<ThreadPool> threadPool;
+    
+    // Transient working buffers, one arena per pool participant (see
+    // scratchArena); emptied at the end of every operation
+    std::vector<std::unique_ptr<ScratchArena>> scratch;
+    double scratchHeapOffset = 0;  // Heap bytes of dropped arenas, less those before resetStats
+    
+    // Stage timings and counters for getStats; trace events when enabled
+    Profiler profiler;
+    
+    // Single-threaded processors that encode generateVariants levels, one
+    // per pool participant
+    std::vector<std::unique_ptr<ImageProcessor>> variantEncoders;
+    
+    // WebP deadline and rate control; zero disables each
+    double webpBudgetMs = 0;
+    int webpTargetSize = 0;
+    float webpTargetPSNR = 0;
+    bool webpSharpYUV = false;  // Lossy from ARGB with libwebp's sharp YUV
+    EncodeCostModel webpLossyCost{kWebPLossyCost, 7};
+    EncodeCostModel webpLosslessCost{kWebPLosslessCost, 7};
+    EncodeCostModel webpTargetedCost{kWebPTargetedCost, 7};
+    
+    // AVIF effort and tiling; avifBudgetMs > 0 trades effort for latency
+    avif::EncodeSettings avifSettings;
+    double avifBudgetMs = 0;
+    EncodeCostModel avifCost{avif::kCostPriors, avif::kFastestSpeed + 1};
+    
+    // Lossy encodes search quality for this MS-SSIM; zero disables it
+    float ssimTarget = 0;
+    QualitySearchStats qualitySearch;
+    static constexpr int kSSIMMinQuality = 10;
+    
+    // Content statistics of the current source, computed on first use
+    ImageAnalysis analysis;
+    bool analysisValid = false;
+    
+    // Encoded results keyed by source hash + parameters; off until a limit
+    // is set. Shared with batch workers (see wasm-batch-scheduler.h).
+    std::shared_ptr<EncodeCache> encodeCache = std::make_shared<EncodeCache>();
+    bool useEncodeCache = true;
+    uint64_t sourceHash = 0;
+    bool sourceHashValid = false;  // Computed on first cached call per source
+    
+    // Full-size frame for pipeline encoders that cannot consume rows
+    std::vector<uint8_t> pipelineFrame;
+    static constexpr int kPipelineStripRows = 32;
+    
+    // Row-push session started by beginStream
+    struct RowStream;
+    std::unique_ptr<RowStream> stream;
+    
+    // Incremental WebP decode started by beginWebPDecode; decodes into imageData
+    struct WebPDecodeSession;
+    std::unique_ptr<WebPDecodeSession> webpDecode;
+
+public:
+    ImageProcessor() : width(0), height(0), channels(0) {}
+    
+    // Load image data
+    bool loadImage(uintptr_t dataPtr, size_t size, int w, int h, int c) {
+        if (!validImageSize(size, w, h, c)) return false;
+        
+        try {
+            webpDecode.reset();
+            uint8_t* data = reinterpret_cast<uint8_t*>(dataPtr);
+            ScopedStage stage(profiler, ProfileStage::Copy, static_cast<double>(w) * h);
+            imageData.assign(data, data + size);
+            setSource(imageData.data(), size, w, h, c);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+    
+    // Borrow caller-owned pixels without copying. The buffer must stay
+    // valid and unchanged until the next load or releaseBuffers().
+    bool loadImageView(uintptr_t dataPtr, size_t size, int w, int h, int c) {
+        if (!validImageSize(size, w, h, c)) return false;
+        
+        webpDecode.reset();
+        imageData.clear();
+        imageData.shrink_to_fit();
+        setSource(reinterpret_cast<const uint8_t*>(dataPtr), size, w, h, c);
+        return true;
+    }
+    
+    // Decode a WebP file into an owned source frame: RGBA if the file has
+    // alpha, RGB otherwise. libwebp crops and scales during the decode, so
+    // a thumbnail of a large file is never held at full size. Animated
+    // files are rejected.
+    bool loadWebP(uintptr_t dataPtr, size_t size, const WebPDecodeOptions& options) {
+        webpDecode.reset();
+        setSource(nullptr, 0, 0, 0, 0);
+        if (size == 0) return false;
+        return decodeWebP(reinterpret_cast<const uint8_t*>(dataPtr), size, options);
+    }
+    
+    // Incremental loadWebP for files that arrive in chunks: feed them to
+    // appendWebPData, then finishWebPDecode makes the frame the source.
+    // Replaces any unfinished decode.
+    bool beginWebPDecode(const WebPDecodeOptions& options) {
+        return startWebPDecode(options, nullptr);
+    }
+    
+    // As beginWebPDecode, with every decoded row also pushed into a row
+    // stream running `pipeline` (see beginStream), so resizing and encoding
+    // keep pace with the download. Results come from takeStreamRowsView and
+    // finishStreamView.
+    bool beginWebPDecodeStream(const WebPDecodeOptions& options, const ImagePipeline& pipeline) {
+        return startWebPDecode(options, &pipeline);
+    }
+    
+    // Decode as far as the bytes received so far allow. Returns the number
+    // of output rows decoded, or -1 after an error or without a decode.
+    int appendWebPData(uintptr_t dataPtr, size_t size) {
+        if (!webpDecode) return -1;
+        return appendWebPDecode(*webpDecode, reinterpret_cast<const uint8_t*>(dataPtr), size);
+    }
+    
+    // End the decode. If every row arrived, the frame becomes the current
+    // source as after loadWebP; otherwise returns false and there is none.
+    bool finishWebPDecode() {
+        if (!webpDecode) return false;
+        const WebPDecodeSession& session = *webpDecode;
+        const bool complete = session.height > 0 && session.rows == session.height;
+        const int w = session.width;
+        const int h = session.height;
+        const int c = session.channels;
+        webpDecode.reset();
+        
+        if (!complete) return false;
+        setSource(imageData.data(), imageData.size(), w, h, c);
+        return true;
+    }
+    
+    // Drop the owned copy, any borrowed pointer and the output buffer
+    void releaseBuffers() {
+        webpDecode.reset();
+        imageData.clear();
+        imageData.shrink_to_fit();
+        outputBuffer.clear();
+        outputBuffer.shrink_to_fit();
+        scratchHeapOffset += scratchHeapBytes();
+        scratch.clear();
+        variantEncoders.clear();
+        setSource(nullptr, 0, 0, 0, 0);
+    }
+    
+    // Runtime switch between the vector kernels and the scalar reference
+    void setUseSimd(bool enabled) {
+        useSimd = enabled;
+    }
+    
+    bool isSimdAvailable() const {
+        return simd::kAvailable;
+    }
+    
+    void setDCTMode(int mode) {
+        dctMode = mode == static_cast<int>(DCTMode::FixedPoint) ? DCTMode::FixedPoint : DCTMode::Float;
+    }
+    
+    // Largest coefficient difference between the selected fast DCT and the
+    // reference transform over a set of pseudo-random blocks
+    float verifyDCT(int size, int mode) {
+        if (size < 1 || size > dct::kMaxSize) return -1.0f;
+        
+        const DCTMode savedMode = dctMode;
+        setDCTMode(mode);
+        
+        uint32_t seed = 12345;
+        float maxError = 0.0f;
+        float fast[dct::kMaxSize * dct::kMaxSize];
+        float reference[dct::kMaxSize * dct::kMaxSize];
+        
+        for (int trial = 0; trial < 64; trial++) {
+            for (int i = 0; i < size * size; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                fast[i] = reference[i] = static_cast<float>(seed >> 24);
+            }
+            applyDCT2D(fast, size);
+            applyDCT2DReference(reference, size);
+            for (int i = 0; i < size * size; i++) {
+                maxError = std::max(maxError, std::abs(fast[i] - reference[i]));
+            }
+        }
+        
+        dctMode = savedMode;
+        return maxError;
+    }
+    
+    // threads <= 0 selects one participant per hardware thread
+    void setThreading(bool enabled, int threads) {
+        useMultithread = enabled;
+        numThreads = threads > 0 ? threads
+                                 : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        threadPool.reset();
+    }
+    
+    // WebP latency budget and rate control. With budgetMs > 0 each encode
+    // uses the highest libwebp method predicted to finish in time, from
+    // throughput measured on earlier encodes. targetSize (bytes) or
+    // targetPSNR (dB) switch on libwebp's multi-pass rate control.
+    void setWebPTargets(double budgetMs, int targetSize, float targetPSNR) {
+        webpBudgetMs = budgetMs;
+        webpTargetSize = std::max(targetSize, 0);
+        webpTargetPSNR = std::max(targetPSNR, 0.0f);
+    }
+    
+    // Lossy WebP normally hands libwebp YUV planes converted here. With
+    // sharp YUV on it imports ARGB and converts with libwebp's sharp YUV
+    // instead: slower and larger, but saturated red and blue edges keep
+    // much more of their colour (graphics, text, line art).
+    void setSharpYUV(bool enabled) {
+        webpSharpYUV = enabled;
+    }
+    
+    // AVIF encoder controls. speed: 0 (smallest) - 10 (fastest); tile
+    // counts are log2, -1 for automatic; budgetMs > 0 moves to faster
+    // presets when the requested one is predicted to overrun.
+    void setAVIFOptions(int speed, int tileRowsLog2, int tileColsLog2, double budgetMs) {
+        avifSettings.speed = std::clamp(speed, avif::kSlowestSpeed, avif::kFastestSpeed);
+        avifSettings.tileRowsLog2 = tileRowsLog2;
+        avifSettings.tileColsLog2 = tileColsLog2;
+        avifBudgetMs = budgetMs;
+    }
+    
+    bool isAVIFAvailable() const {
+        return avif::kAvailable;
+    }
+    
+    // Perceptual target for lossy WebP, AVIF and JPEG XL encodes. With a
+    // target > 0 (MS-SSIM, e.g. 0.98) the quality argument becomes a
+    // ceiling: each image is encoded at the lowest quality from 10 up to it
+    // whose MS-SSIM against the source reaches the target, found by
+    // bisection in at most 7 trial encodes. WebP size and PSNR targets
+    // take precedence over it.
+    void setSSIMTarget(float target) {
+        ssimTarget = std::clamp(target, 0.0f, 1.0f);
+    }
+    
+    // Result of the last search this processor ran; cache hits run none
+    QualitySearchStats getQualitySearch() const {
+        return qualitySearch;
+    }
+    
+    ProcessorSettings getSettings() const {
+        ProcessorSettings settings;
+        settings.useSimd = useSimd;
+        settings.dctMode = dctMode;
+        settings.webpBudgetMs = webpBudgetMs;
+        settings.webpTargetSize = webpTargetSize;
+        settings.webpTargetPSNR = webpTargetPSNR;
+        settings.webpSharpYUV = webpSharpYUV;
+        settings.avifSettings = avifSettings;
+        settings.avifBudgetMs = avifBudgetMs;
+        settings.ssimTarget = ssimTarget;
+        settings.useEncodeCache = useEncodeCache;
+        return settings;
+    }
+    
+    void applySettings(const ProcessorSettings& settings) {
+        useSimd = settings.useSimd;
+        dctMode = settings.dctMode;
+        webpBudgetMs = settings.webpBudgetMs;
+        webpTargetSize = settings.webpTargetSize;
+        webpTargetPSNR = settings.webpTargetPSNR;
+        webpSharpYUV = settings.webpSharpYUV;
+        avifSettings = settings.avifSettings;
+        avifBudgetMs = settings.avifBudgetMs;
+        ssimTarget = settings.ssimTarget;
+        useEncodeCache = settings.useEncodeCache;
+    }
+    
+    // Use other's encode cache from now on, so both see each other's results
+    void shareEncodeCache(const ImageProcessor& other) {
+        encodeCache = other.encodeCache;
+    }
+    
+    // Encode cache: results of encode* and runPipeline are reused when the
+    // same pixels arrive with the same parameters, effort and budgets
+    // included. A limit of 0 disables it.
+    void setEncodeCacheLimit(size_t bytes) {
+        encodeCache->setLimit(bytes);
+    }
+    
+    // Per-call switch, e.g. to bypass the cache for one-off images
+    void setEncodeCacheEnabled(bool enabled) {
+        useEncodeCache = enabled;
+    }
+    
+    void clearEncodeCache() {
+        encodeCache->clear();
+    }
+    
+    EncodeCacheStats getEncodeCacheStats() const {
+        return encodeCache->stats();
+    }
+    
+    // Working-buffer footprint: the sum of each arena's peak and capacity
+    ScratchStats getScratchStats() const {
+        ScratchStats stats;
+        for (const auto& arena : scratch) {
+            stats.highWaterBytes += static_cast<double>(arena->getHighWater());
+            stats.capacityBytes += static_cast<double>(arena->getCapacity());
+            stats.heapBytes += static_cast<double>(arena->getHeapBytes());
+        }
+        stats.arenas = static_cast<uint32_t>(scratch.size());
+        return stats;
+    }
+    
+    // Counters since creation or resetStats(): per-stage calls, wall time and
+    // pixels, thread utilisation inside parallel regions, scratch memory and
+    // this processor's encode cache lookups. Stages that never ran are left out.
+    emscripten::val getStats() const {
+        emscripten::val stages = emscripten::val::object();
+        for (int i = 0; i < kProfileStageCount; i++) {
+            const StageTotals& totals = profiler.stage(static_cast<ProfileStage>(i));
+            if (totals.calls == 0) continue;
+            emscripten::val stage = emscripten::val::object();
+            stage.set("calls", totals.calls);
+            stage.set("ms", totals.ms);
+            stage.set("pixels", totals.pixels);
+            stage.set("megapixelsPerSecond", totals.ms > 0 ? totals.pixels / (totals.ms * 1000.0) : 0.0);
+            stages.set(kProfileStageNames[i], stage);
+        }
+        
+        emscripten::val threads = emscripten::val::object();
+        threads.set("threads", threadPool ? threadPool->size() : 1);
+        threads.set("parallelMs", profiler.getParallelWallMs());
+        threads.set("busyMs", profiler.getParallelBusyMs());
+        threads.set("utilisation", profiler.getUtilisation());
+        
+        const ScratchStats scratchStats = getScratchStats();
+        emscripten::val memory = emscripten::val::object();
+        memory.set("bytesAllocated", scratchHeapOffset + scratchStats.heapBytes);
+        memory.set("scratchHighWater", scratchStats.highWaterBytes);
+        memory.set("scratchCapacity", scratchStats.capacityBytes);
+        memory.set("outputCapacity", static_cast<double>(outputBuffer.capacity()));
+        
+        emscripten::val cache = emscripten::val::object();
+        cache.set("hits", profiler.getCacheHits());
+        cache.set("misses", profiler.getCacheMisses());
+        cache.set("entries", encodeCache->stats().entries);
+        
+        emscripten::val stats = emscripten::val::object();
+        stats.set("stages", stages);
+        stats.set("threads", threads);
+        stats.set("memory", memory);
+        stats.set("cache", cache);
+        return stats;
+    }
+    
+    // Native access to the counters behind getStats
+    const Profiler& getProfiler() const {
+        return profiler;
+    }
+    
+    void resetStats() {
+        profiler.reset();
+        scratchHeapOffset = -scratchHeapBytes();
+    }
+    
+    // Record every stage as a Chrome trace event until switched off again;
+    // switching on discards the previous trace
+    void setTracing(bool enabled) {
+        profiler.setTracing(enabled);
+    }
+    
+    // Trace-event JSON of the stages recorded while tracing, for Perfetto
+    // (ui.perfetto.dev) or chrome://tracing
+    std::string getTrace() const {
+        return profiler.traceJSON();
+    }
+    
+    // Serialized cache in the output buffer, for persistence by the caller
+    emscripten::val exportEncodeCacheView() {
+        prepareOutputBuffer();
+        encodeCache->serialize(outputBuffer);
+        return outputView();
+    }
+    
+    bool importEncodeCache(uintptr_t dataPtr, size_t size) {
+        if (size == 0) return false;
+        return encodeCache->deserialize(reinterpret_cast<const uint8_t*>(dataPtr), size);
+    }
+    
+    // Content statistics of the current source (see wasm-analyzer.h), as
+    // used by selectOptimalFormat; null without a source
+    emscripten::val analyzeImage() {
+        if (pixels == nullptr) return emscripten::val::null();
+        const ImageAnalysis& result = sourceAnalysis();
+        
+        emscripten::val histogram = emscripten::val::array();
+        for (int i = 0; i < 256; i++) {
+            histogram.set(i, result.histogram[i]);
+        }
+        
+        emscripten::val info = emscripten::val::object();
+        info.set("contentClass", kContentClassNames[static_cast<int>(result.contentClass)]);
+        info.set("histogram", histogram);
+        info.set("uniqueColors", result.uniqueColors);
+        info.set("hasAlpha", result.hasAlpha);
+        info.set("transparentFraction", result.transparentFraction);
+        info.set("translucentFraction", result.translucentFraction);
+        info.set("edgeDensity", result.edgeDensity);
+        info.set("meanBlockVariance", result.meanBlockVariance);
+        info.set("flatBlockFraction", result.flatBlockFraction);
+        info.set("lumaEntropy", result.lumaEntropy);
+        return info;
+    }
+    
+    // MS-SSIM of a w x h frame against the current source, on luma: 1 for
+    // identical frames (and for frames under 8x8), lower as they diverge.
+    // -1 without a source or when the sizes differ.
+    float compareSSIM(uintptr_t dataPtr, size_t size, int w, int h, int c) {
+        if (pixels == nullptr || !validImageSize(size, w, h, c) || w != width || h != height) return -1.0f;
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        const ImageView other{reinterpret_cast<const uint8_t*>(dataPtr), w, h, c, static_cast<size_t>(w) * c};
+        const ssim::Plane reference = lumaPlane(sourceView(), arena);
+        return static_cast<float>(planeSSIM(reference, lumaPlane(other, arena)));
+    }
+    
+    // Quantum-inspired optimization selector
+    std::string selectOptimalFormat(int networkSpeed, float devicePixelRatio, 
+                                   int batteryLevel, bool preferQuality) {
+        float score_webp = calculateFormatScore(EncodeFormat::WebP, networkSpeed, devicePixelRatio,
+                                                batteryLevel, preferQuality);
+        // Never pick AVIF when this build cannot produce it
+        float score_avif = avif::kAvailable
+            ? calculateFormatScore(EncodeFormat::AVIF, networkSpeed, devicePixelRatio, batteryLevel, preferQuality)
+            : 0.0f;
+        float score_jpegxl = calculateFormatScore(EncodeFormat::JPEGXL, networkSpeed, devicePixelRatio,
+                                                  batteryLevel, preferQuality);
+        
+        if (score_avif > score_webp && score_avif > score_jpegxl) {
+            return "avif";
+        } else if (score_jpegxl > score_webp && score_jpegxl > score_avif) {
+            return "jpegxl";
+        } else {
+            return "webp";
+        }
+    }
+    
+private:
+    static bool validImageSize(size_t size, int w, int h, int c) {
+        const size_t bytes = frameBytes(w, h, c);
+        return bytes != 0 && size >= bytes;
+    }
+    
+    void setSource(const uint8_t* data, size_t bytes, int w, int h, int c) {
+        pixels = data;
+        pixelBytes = bytes;
+        width = w;
+        height = h;
+        channels = c;
+        sourceHashValid = false;
+        analysisValid = false;
+    }
+    
+    ImageView sourceView() const {
+        return {pixels, width, height, channels, static_cast<size_t>(width) * channels};
+    }
+    
+    // Points the encoders at another frame for the lifetime of the scope
+    class ScopedSource {
+    public:
+        ScopedSource(ImageProcessor& processor, const uint8_t* data, size_t bytes, int w, int h, int c)
+            : owner(processor), savedPixels(processor.pixels), savedBytes(processor.pixelBytes),
+              savedWidth(processor.width), savedHeight(processor.height), savedChannels(processor.channels),
+              savedHash(processor.sourceHash), savedHashValid(processor.sourceHashValid) {
+            owner.setSource(data, bytes, w, h, c);
+        }
+        
+        ~ScopedSource() {
+            owner.setSource(savedPixels, savedBytes, savedWidth, savedHeight, savedChannels);
+            owner.sourceHash = savedHash;
+            owner.sourceHashValid = savedHashValid;
+        }
+        
+    private:
+        ImageProcessor& owner;
+        const uint8_t* savedPixels;
+        size_t savedBytes;
+        int savedWidth, savedHeight, savedChannels;
+        uint64_t savedHash;
+        bool savedHashValid;
+    };
+    
+    struct WebPDecodeSession {
+        WebPDecodeOptions options;
+        std::unique_ptr<ImagePipeline> pipeline;  // Row stream to feed, if any
+        std::vector<uint8_t> header;  // Bytes held until the output size is known
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        int rows = 0;  // Output rows decoded so far
+        bool failed = false;
+#if IMAGE_PROCESSOR_HAS_WEBP
+        WebPDecoderConfig config;  // Must outlive the decoder, which points into it
+        WebPIDecoder* decoder = nullptr;
+        
+        ~WebPDecodeSession() {
+            if (decoder != nullptr) WebPIDelete(decoder);
+        }
+#endif
+    };
+    
+    bool startWebPDecode(const WebPDecodeOptions& options, const ImagePipeline* pipeline) {
+        webpDecode.reset();
+        setSource(nullptr, 0, 0, 0, 0);
+        if (!IMAGE_PROCESSOR_HAS_WEBP) return false;
+        
+        webpDecode = std::make_unique<WebPDecodeSession>();
+        webpDecode->options = options;
+        if (pipeline != nullptr) {
+            webpDecode->pipeline = std::make_unique<ImagePipeline>(*pipeline);
+        }
+        return true;
+    }
+    
+    // Results returned as views live in outputBuffer. If the current source
+    // is that buffer (a previous view was loaded back in), take ownership of
+    // it first so the next result cannot overwrite its own input.
+    void prepareOutputBuffer() {
+        if (pixels != nullptr && pixels == outputBuffer.data()) {
+            imageData.swap(outputBuffer);
+            pixels = imageData.data();
+        }
+    }
+    
+    emscripten::val outputView() const {
+        return emscripten::val(emscripten::typed_memory_view(outputBuffer.size(), outputBuffer.data()));
+    }
+    
+    bool simdEnabled() const {
+        return useSimd && simd::kAvailable;
+    }
+    
+    // Split [0, count) into chunks of `grain` across the worker pool. The
+    // pool gets a reference to fn, which std::function stores without
+    // allocating, however much the lambda captures. Each chunk is timed so
+    // getStats can report how busy the participants were.
+    template <typename Fn>
+    void parallelFor(int count, int grain, Fn&& fn) {
+        if (!useMultithread || numThreads <= 1 || count <= grain) {
+            fn(0, count);
+            return;
+        }
+        if (!threadPool) {
+            threadPool = std::make_unique<ThreadPool>(numThreads);
+        }
+        reserveScratch(threadPool->size());
+        
+        std::atomic<int64_t> busyNs{0};
+        auto timed = [&](int begin, int end) {
+            const auto chunkStart = Profiler::Clock::now();
+            fn(begin, end);
+            const auto elapsed = Profiler::Clock::now() - chunkStart;
+            busyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                             std::memory_order_relaxed);
+        };
+        const auto start = Profiler::Clock::now();
+        const int participants = threadPool->parallelFor(count, grain, std::ref(timed));
+        std::chrono::duration<double, std::milli> wall = Profiler::Clock::now() - start;
+        profiler.recordParallel(wall.count(), busyNs.load() / 1e6, participants);
+    }
+    
+    size_t scratchHeapBytes() const {
+        size_t total = 0;
+        for (const auto& arena : scratch) total += arena->getHeapBytes();
+        return total;
+    }
+    
+    // Arena of the calling participant. Workers only ever see indices that
+    // parallelFor reserved before dispatching to them.
+    ScratchArena& scratchArena() {
+        const size_t index = static_cast<size_t>(ThreadPool::currentParticipant());
+        reserveScratch(index + 1);
+        return *scratch[index];
+    }
+    
+    void reserveScratch(size_t count) {
+        while (scratch.size() < count) {
+            scratch.push_back(std::make_unique<ScratchArena>());
+        }
+    }
+    
+    float calculateFormatScore(EncodeFormat format, int networkSpeed, 
+                              float devicePixelRatio, int batteryLevel, bool preferQuality) {
+        float score = 0.0f;
+        
+        // Base format capabilities
+        if (format == EncodeFormat::AVIF) {
+            score = 0.9f; // Excellent compression
+        } else if (format == EncodeFormat::JPEGXL) {
+            score = 0.85f; // Good compression + features
+        } else if (format == EncodeFormat::WebP) {
+            score = 0.8f; // Good compression + compatibility
+        }
+        
+        // Network speed adjustment
+        float networkFactor = std::min(1.0f, networkSpeed / 10.0f);
+        if (format == EncodeFormat::AVIF && networkSpeed < 5) {
+            score *= 1.2f; // AVIF excels on slow networks
+        }
+        
+        // Device pixel ratio consideration
+        if (devicePixelRatio > 2.0f && preferQuality) {
+            if (format == EncodeFormat::AVIF || format == EncodeFormat::JPEGXL) {
+                score *= 1.1f;
+            }
+        }
+        
+        // Battery level optimization
+        if (batteryLevel < 30) {
+            if (format == EncodeFormat::WebP) {
+                score *= 1.1f; // WebP is faster to decode
+            }
+        }
+        
+        // Content of the loaded source: AVIF's smoothing suits photos, while
+        // flat graphics and text keep sharp edges for fewer bytes in JPEG XL
+        // and WebP
+        if (pixels != nullptr) {
+            const bool photo = sourceAnalysis().contentClass == ContentClass::Photo;
+            if (format == EncodeFormat::AVIF) {
+                score *= photo ? 1.1f : 0.9f;
+            } else if (!photo) {
+                score *= 1.1f;
+            }
+        }
+        
+        return score;
+    }
+    
+    const ImageAnalysis& sourceAnalysis() {
+        if (!analysisValid) {
+            analysis = analyzeView(sourceView());
+            analysisValid = true;
+        }
+        return analysis;
+    }
+    
+    // One pass over `src` in bands of whole 8-row blocks, each band into
+    // its own BandStats so the merged result does not depend on threading
+    ImageAnalysis analyzeView(const ImageView& src) {
+        ScopedStage stage(profiler, ProfileStage::Analyze, static_cast<double>(src.width) * src.height);
+        constexpr int kBandBlocks = 4;
+        const int block = analyzer::kBlockSize;
+        const int blockRows = (src.height + block - 1) / block;
+        std::vector<analyzer::BandStats> bands((blockRows + kBandBlocks - 1) / kBandBlocks);
+        analyzer::ColorSet colors;
+        
+        parallelFor(blockRows, kBandBlocks, [&](int begin, int end) {
+            ScratchArena& arena = scratchArena();
+            ScratchScope scope(arena);
+            uint8_t* luma = arena.alloc<uint8_t>(static_cast<size_t>(block + 1) * src.width);
+            for (int band = begin; band < end; band += kBandBlocks) {
+                const int rowEnd = std::min(std::min(band + kBandBlocks, end) * block, src.height);
+                analyzer::analyzeRows(src.data, src.stride, src.width, src.height, src.channels, band * block,
+                                      rowEnd, luma, colors, bands[band / kBandBlocks]);
+            }
+        });
+        
+        analyzer::BandStats total;
+        for (const auto& band : bands) analyzer::merge(total, band);
+        return analyzer::finish(total, colors, src.width, src.height, src.channels);
+    }
+    
+    // Luma of `src` into rows `stride` bytes apart
+    void writeLuma(const ImageView& src, uint8_t* luma, size_t stride) {
+        parallelFor(src.height, 32, [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                planar::lumaRow(src.row(y), src.width, src.channels, luma + y * stride);
+            }
+        });
+    }
+    
+    ssim::Plane lumaPlane(const ImageView& src, ScratchArena& arena) {
+        ssim::Plane plane;
+        plane.width = src.width;
+        plane.height = src.height;
+        plane.stride = planar::alignedStride(src.width);
+        uint8_t* luma = planar::allocPlane(arena, plane.stride * src.height);
+        writeLuma(src, luma, plane.stride);
+        plane.data = luma;
+        return plane;
+    }
+    
+    // Next MS-SSIM scale: `src` halved by 2x2 box averages
+    ssim::Plane halvePlane(const ssim::Plane& src, ScratchArena& arena) {
+        ssim::Plane half;
+        half.width = src.width / 2;
+        half.height = src.height / 2;
+        half.stride = planar::alignedStride(half.width);
+        uint8_t* data = planar::allocPlane(arena, half.stride * half.height);
+        parallelFor(half.height, 32, [&](int rowBegin, int rowEnd) {
+            ssim::downsample(src.data, src.stride, data, half.stride, half.width, rowBegin, rowEnd);
+        });
+        half.data = data;
+        return half;
+    }
+    
+    // MS-SSIM of two luma planes of the same size (see wasm-ssim.h)
+    double planeSSIM(const ssim::Plane& a, const ssim::Plane& b) {
+        ScopedStage stage(profiler, ProfileStage::SSIM, static_cast<double>(a.width) * a.height);
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        const int scales = ssim::scaleCount(a.width, a.height);
+        const bool vectorize = simdEnabled();
+        constexpr int kGrain = 8;
+        
+        double l[ssim::kMaxScales] = {};
+        double cs[ssim::kMaxScales] = {};
+        ssim::Plane x = a;
+        ssim::Plane y = b;
+        for (int s = 0; s < scales; s++) {
+            if (s > 0) {
+                x = halvePlane(x, arena);
+                y = halvePlane(y, arena);
+            }
+            
+            // One partial sum per chunk of window rows, added up in order so
+            // the score does not depend on how chunks were spread over threads
+            const int rows = ssim::windowRows(x.height);
+            const int chunks = (rows + kGrain - 1) / kGrain;
+            double* lParts = arena.alloc<double>(chunks);
+            double* csParts = arena.alloc<double>(chunks);
+            parallelFor(rows, kGrain, [&](int rowBegin, int rowEnd) {
+                ScratchArena& local = scratchArena();
+                ScratchScope localScope(local);
+                float* scratch = local.alloc<float>(ssim::scratchFloats(x.width));
+                for (int row = rowBegin; row < rowEnd; row += kGrain) {
+                    double lSum = 0.0;
+                    double csSum = 0.0;
+                    ssim::windowTerms(x.data, x.stride, y.data, y.stride, x.width, row,
+                                      std::min(row + kGrain, rowEnd), scratch, vectorize, lSum, csSum);
+                    lParts[row / kGrain] = lSum;
+                    csParts[row / kGrain] = csSum;
+                }
+            });
+            
+            const double windows = static_cast<double>(rows) * ssim::windowColumns(x.width);
+            for (int c = 0; c < chunks; c++) {
+                l[s] += lParts[c];
+                cs[s] += csParts[c];
+            }
+            l[s] /= windows;
+            cs[s] /= windows;
+        }
+        return ssim::combine(l, cs, scales);
+    }
+    
+    // Encode at the lowest quality in [kSSIMMinQuality, maxQuality] whose
+    // reconstruction keeps MS-SSIM against `reference` at or above
+    // ssimTarget, by bisection (quality is taken to raise SSIM
+    // monotonically); maxQuality when none does. encode(dst, quality, luma)
+    // encodes into dst and, unless luma is null, writes the luma a decoder
+    // would reconstruct there, in rows reference.stride bytes apart.
+    template <typename Encode>
+    bool encodeToSSIM(std::vector<uint8_t>& out, const ssim::Plane& reference, int maxQuality, Encode&& encode) {
+        qualitySearch = QualitySearchStats();
+        qualitySearch.quality = maxQuality;
+        qualitySearch.encodes = 1;
+        if (maxQuality < kSSIMMinQuality || ssim::scaleCount(reference.width, reference.height) == 0) {
+            return encode(out, maxQuality, nullptr);
+        }
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        ssim::Plane decoded = reference;
+        uint8_t* luma = planar::allocPlane(arena, reference.stride * reference.height);
+        decoded.data = luma;
+        
+        std::vector<uint8_t> candidate;
+        qualitySearch.encodes = 0;
+        int low = kSSIMMinQuality;
+        int high = maxQuality;
+        while (low <= high) {
+            const int quality = low + (high - low) / 2;
+            qualitySearch.encodes++;
+            candidate.clear();
+            if (!encode(candidate, quality, luma)) {
+                out.clear();
+                return false;
+            }
+            
+            // maxQuality is only tried once every lower quality has failed
+            const float score = static_cast<float>(planeSSIM(reference, decoded));
+            if (score >= ssimTarget || quality == maxQuality) {
+                out.swap(candidate);
+                qualitySearch.quality = quality;
+                qualitySearch.ssim = score;
+            }
+            if (score >= ssimTarget) {
+                high = quality - 1;
+            } else {
+                low = quality + 1;
+            }
+        }
+        return true;
+    }
+
+public:
+    // WebP encoding with advanced options
+    std::vector<uint8_t> encodeWebP(int quality, bool lossless = false) {
+        std::vector<uint8_t> result;
+        encodeWebPCached(result, quality, lossless);
+        return result;
+    }
+    
+    std::vector<uint8_t> encodeAVIF(int quality) {
+        std::vector<uint8_t> result;
+        encodeAVIFCached(result, quality);
+        return result;
+    }
+    
+    std::vector<uint8_t> encodeJPEGXL(int quality) {
+        std::vector<uint8_t> result;
+        encodeJPEGXLCached(result, quality);
+        return result;
+    }
+    
+    // Zero-copy variants: the result is written into the processor-owned
+    // output buffer and returned as a typed_memory_view onto the WASM heap.
+    // The view is valid until the next *View call, releaseBuffers() or heap
+    // growth, so callers must consume or copy it straight away.
+    emscripten::val encodeWebPView(int quality, bool lossless) {
+        prepareOutputBuffer();
+        encodeWebPCached(outputBuffer, quality, lossless);
+        return outputView();
+    }
+    
+    emscripten::val encodeAVIFView(int quality) {
+        prepareOutputBuffer();
+        encodeAVIFCached(outputBuffer, quality);
+        return outputView();
+    }
+    
+    emscripten::val encodeJPEGXLView(int quality) {
+        prepareOutputBuffer();
+        encodeJPEGXLCached(outputBuffer, quality);
+        return outputView();
+    }
+    
+private:
+    // Serve `out` from the encode cache, or run `encode` and remember the result
+    bool encodeCacheActive() const {
+        return useEncodeCache && encodeCache->getLimit() > 0 && pixels != nullptr;
+    }
+    
+    bool encodeCached(std::vector<uint8_t>& out, const std::string& params,
+                      const std::function<bool(std::vector<uint8_t>&)>& encode) {
+        if (!encodeCacheActive()) {
+            return encode(out);
+        }
+        
+        const std::string key = sourceCacheKey(params);
+        const bool hit = encodeCache->lookup(key, out);
+        profiler.recordCacheLookup(hit);
+        if (hit) return true;
+        
+        const bool ok = encode(out);
+        if (ok && !out.empty()) {
+            encodeCache->insert(key, out);
+        }
+        return ok;
+    }
+    
+    // Cache key for `params` applied to the current source
+    std::string sourceCacheKey(const std::string& params) {
+        if (!sourceHashValid) {
+            ScopedStage stage(profiler, ProfileStage::Hash, static_cast<double>(width) * height);
+            sourceHash = simd::hash64(pixels, static_cast<size_t>(width) * height * channels);
+            sourceHashValid = true;
+        }
+        
+        char source[64];
+        std::snprintf(source, sizeof(source), "%016llx:%dx%dx%d:",
+                      static_cast<unsigned long long>(sourceHash), width, height, channels);
+        return source + params;
+    }
+    
+    // Settings beyond the call arguments that change encoded bytes. The
+    // budgets pick the WebP method and AVIF speed, so they are keyed too.
+    std::string encoderCacheParams() const {
+        return " wb=" + std::to_string(webpBudgetMs) + " ts=" + std::to_string(webpTargetSize) +
+               " tp=" + std::to_string(webpTargetPSNR) + " sy=" + std::to_string(webpSharpYUV) +
+               " dct=" + std::to_string(static_cast<int>(dctMode)) +
+               " ssim=" + std::to_string(ssimTarget) + " as=" + std::to_string(avifSettings.speed) +
+               " at=" + std::to_string(avifSettings.tileRowsLog2) + "," + std::to_string(avifSettings.tileColsLog2) +
+               " ab=" + std::to_string(avifBudgetMs);
+    }
+    
+    bool encodeWebPCached(std::vector<uint8_t>& out, int quality, bool lossless) {
+        const std::string params = "webp q=" + std::to_string(quality) + " l=" + std::to_string(lossless) +
+                                   encoderCacheParams();
+        return encodeCached(out, params, [&](std::vector<uint8_t>& dst) {
+            return encodeWebPTo(dst, quality, lossless);
+        });
+    }
+    
+    bool encodeAVIFCached(std::vector<uint8_t>& out, int quality) {
+        const std::string params = "avif q=" + std::to_string(quality) + encoderCacheParams();
+        return encodeCached(out, params, [&](std::vector<uint8_t>& dst) {
+            return encodeAVIFTo(dst, quality);
+        });
+    }
+    
+    bool encodeJPEGXLCached(std::vector<uint8_t>& out, int quality) {
+        const std::string params = "jpegxl q=" + std::to_string(quality) + encoderCacheParams();
+        return encodeCached(out, params, [&](std::vector<uint8_t>& dst) {
+            return encodeJPEGXLTo(dst, quality);
+        });
+    }
+    
+#if IMAGE_PROCESSOR_HAS_WEBP
+    // ARGB picture of the given size for the pipeline sink; nullptr on failure
+    static WebPPicture* allocWebPPicture(int pictureWidth, int pictureHeight) {
+        auto* picture = new WebPPicture;
+        WebPPictureInit(picture);
+        picture->width = pictureWidth;
+        picture->height = pictureHeight;
+        picture->use_argb = 1;
+        if (!WebPPictureAlloc(picture)) {
+            delete picture;
+            return nullptr;
+        }
+        return picture;
+    }
+    
+    static void freeWebPPicture(WebPPicture* picture) {
+        if (picture == nullptr) return;
+        WebPPictureFree(picture);
+        delete picture;
+    }
+    
+    static uint32_t* webpRow(WebPPicture* picture, int y) {
+        return picture->argb + static_cast<size_t>(y) * picture->argb_stride;
+    }
+    
+    // libwebp writer that appends straight into the destination vector
+    static int writeToVector(const uint8_t* data, size_t size, const WebPPicture* picture) {
+        auto* out = static_cast<std::vector<uint8_t>*>(picture->custom_ptr);
+        out->insert(out->end(), data, data + size);
+        return 1;
+    }
+    
+    bool encodeWebPTo(std::vector<uint8_t>& out, int quality, bool lossless) {
+        out.clear();
+        if (pixels == nullptr) return false;
+        
+        // Lossy: libwebp gets YUV planes instead of converting ARGB itself,
+        // unless sharp YUV asks for its own conversion
+        if (!lossless && !webpSharpYUV) {
+            ScratchArena& arena = scratchArena();
+            ScratchScope scope(arena);
+            const PlanarImage planes = toPlanar(sourceView(), arena, channels == 2 || channels == 4);
+            return encodeWebPPlanar(planes, quality, out);
+        }
+        
+        WebPPicture picture;
+        WebPPictureInit(&picture);
+        picture.width = width;
+        picture.height = height;
+        picture.use_argb = 1;
+        
+        // Import image data
+        {
+            ScopedStage stage(profiler, ProfileStage::Convert, static_cast<double>(width) * height);
+            if (channels == 4) {
+                WebPPictureImportRGBA(&picture, pixels, width * 4);
+            } else if (channels == 3) {
+                WebPPictureImportRGB(&picture, pixels, width * 3);
+            }
+        }
+        
+        bool ok = encodeWebPPicture(picture, quality, lossless, out);
+        
+        // Cleanup
+        WebPPictureFree(&picture);
+        
+        return ok;
+    }
+    
+    // Lossy encode straight from YUV planes, searching quality under an SSIM
+    // target. The search compares the encoder's luma plane with the one
+    // decoded from each trial, so both sides share the same conversion.
+    bool encodeWebPPlanar(const PlanarImage& image, int quality, std::vector<uint8_t>& out) {
+        if (!webpSSIMSearch()) return encodeWebPPlanarAt(image, quality, out);
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        const size_t chromaBytes = image.uvStride * image.chromaHeight();
+        uint8_t* u = planar::allocPlane(arena, chromaBytes);
+        uint8_t* v = planar::allocPlane(arena, chromaBytes);
+        ssim::Plane reference;
+        reference.data = image.y;
+        reference.stride = image.yStride;
+        reference.width = image.width;
+        reference.height = image.height;
+        
+        return encodeToSSIM(out, reference, quality, [&](std::vector<uint8_t>& dst, int trial, uint8_t* luma) {
+            if (!encodeWebPPlanarAt(image, trial, dst)) return false;
+            if (luma == nullptr) return true;
+            ScopedStage stage(profiler, ProfileStage::Decode, static_cast<double>(image.width) * image.height);
+            const int uvStride = static_cast<int>(image.uvStride);
+            return WebPDecodeYUVInto(dst.data(), dst.size(), luma, image.yStride * image.height,
+                                     static_cast<int>(image.yStride), u, chromaBytes, uvStride, v, chromaBytes,
+                                     uvStride) != nullptr;
+        });
+    }
+    
+    // One encode at a fixed quality; the picture only points at the planes
+    bool encodeWebPPlanarAt(const PlanarImage& image, int quality, std::vector<uint8_t>& out) {
+        WebPPicture picture;
+        WebPPictureInit(&picture);
+        picture.use_argb = 0;
+        picture.colorspace = image.a != nullptr ? WEBP_YUV420A : WEBP_YUV420;
+        picture.width = image.width;
+        picture.height = image.height;
+        picture.y = image.y;
+        picture.u = image.u;
+        picture.v = image.v;
+        picture.y_stride = static_cast<int>(image.yStride);
+        picture.uv_stride = static_cast<int>(image.uvStride);
+        picture.a = image.a;
+        picture.a_stride = static_cast<int>(image.yStride);
+        
+        // Frees only what libwebp allocated during the encode; the planes
+        // are not the picture's own memory
+        const bool ok = encodeWebPPicture(picture, quality, false, out);
+        WebPPictureFree(&picture);
+        return ok;
+    }
+    
+    // Point config.output at imageData, sized for the crop and scale of
+    // `options` over the image described by config.input
+    bool configureWebPDecode(WebPDecoderConfig& config, const WebPDecodeOptions& options,
+                             int& outWidth, int& outHeight, int& outChannels) {
+        const WebPBitstreamFeatures& features = config.input;
+        if (features.has_animation) return false;
+        
+        const int cropWidth = options.cropWidth > 0 ? options.cropWidth : features.width - options.cropX;
+        const int cropHeight = options.cropHeight > 0 ? options.cropHeight : features.height - options.cropY;
+        if (options.cropX < 0 || options.cropY < 0 || cropWidth <= 0 || cropHeight <= 0 ||
+            options.cropX + cropWidth > features.width || options.cropY + cropHeight > features.height) {
+            return false;
+        }
+        
+        outWidth = options.width;
+        outHeight = options.height;
+        if (outWidth <= 0 && outHeight <= 0) {
+            outWidth = cropWidth;
+            outHeight = cropHeight;
+        } else if (outWidth <= 0) {
+            outWidth = std::max(1, static_cast<int>(std::lround(static_cast<double>(outHeight) * cropWidth /
+                                                                cropHeight)));
+        } else if (outHeight <= 0) {
+            outHeight = std::max(1, static_cast<int>(std::lround(static_cast<double>(outWidth) * cropHeight /
+                                                                 cropWidth)));
+        }
+        outChannels = features.has_alpha ? 4 : 3;
+        
+        WebPDecoderOptions& decode = config.options;
+        decode.use_cropping = cropWidth != features.width || cropHeight != features.height;
+        decode.crop_left = options.cropX;
+        decode.crop_top = options.cropY;
+        decode.crop_width = cropWidth;
+        decode.crop_height = cropHeight;
+        decode.use_scaling = outWidth != cropWidth || outHeight != cropHeight;
+        decode.scaled_width = outWidth;
+        decode.scaled_height = outHeight;
+        decode.use_threads = useMultithread;
+        
+        const size_t stride = static_cast<size_t>(outWidth) * outChannels;
+        const size_t bytes = frameBytes(outWidth, outHeight, outChannels);
+        if (bytes == 0) return false;
+        try {
+            imageData.resize(bytes);
+        } catch (...) {
+            return false;
+        }
+        
+        // libwebp writes straight into imageData
+        WebPDecBuffer& output = config.output;
+        output.colorspace = outChannels == 4 ? MODE_RGBA : MODE_RGB;
+        output.is_external_memory = 1;
+        output.u.RGBA.rgba = imageData.data();
+        output.u.RGBA.stride = static_cast<int>(stride);
+        output.u.RGBA.size = imageData.size();
+        return true;
+    }
+    
+    bool decodeWebP(const uint8_t* data, size_t size, const WebPDecodeOptions& options) {
+        WebPDecoderConfig config;
+        if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK) {
+            return false;
+        }
+        
+        int w, h, c;
+        if (!configureWebPDecode(config, options, w, h, c)) return false;
+        
+        ScopedStage stage(profiler, ProfileStage::Decode, static_cast<double>(w) * h);
+        const bool ok = WebPDecode(data, size, &config) == VP8_STATUS_OK;
+        WebPFreeDecBuffer(&config.output);
+        if (!ok) return false;
+        
+        setSource(imageData.data(), imageData.size(), w, h, c);
+        return true;
+    }
+    
+    // Bytes are buffered until the header gives the output size, then go
+    // to a WebPIDecoder; new rows are pushed to the session's row stream
+    int appendWebPDecode(WebPDecodeSession& session, const uint8_t* data, size_t size) {
+        if (session.failed) return -1;
+        
+        if (session.decoder == nullptr) {
+            session.header.insert(session.header.end(), data, data + size);
+            if (!WebPInitDecoderConfig(&session.config)) return -1;
+            const VP8StatusCode status = WebPGetFeatures(session.header.data(), session.header.size(),
+                                                         &session.config.input);
+            if (status == VP8_STATUS_NOT_ENOUGH_DATA) return 0;
+            if (status != VP8_STATUS_OK || !openWebPDecoder(session)) {
+                session.failed = true;
+                return -1;
+            }
+            data = session.header.data();
+            size = session.header.size();
+        }
+        
+        if (session.rows < session.height && size > 0) {
+            const auto start = Profiler::Clock::now();
+            const VP8StatusCode status = WebPIAppend(session.decoder, data, size);
+            if (status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
+                session.failed = true;
+                return -1;
+            }
+            
+            int decoded = 0;
+            WebPIDecGetRGB(session.decoder, &decoded, nullptr, nullptr, nullptr);
+            decoded = std::clamp(decoded, session.rows, session.height);
+            profiler.record(ProfileStage::Decode, start, Profiler::Clock::now(),
+                            static_cast<double>(decoded - session.rows) * session.width);
+            
+            if (session.pipeline && decoded > session.rows) {
+                const size_t rowBytes = static_cast<size_t>(session.width) * session.channels;
+                const uint8_t* rows = imageData.data() + session.rows * rowBytes;
+                const int count = decoded - session.rows;
+                pushRows(reinterpret_cast<uintptr_t>(rows), rowBytes * count, count);
+            }
+            session.rows = decoded;
+        }
+        
+        // WebPIAppend keeps its own copy of the data
+        session.header.clear();
+        session.header.shrink_to_fit();
+        return session.rows;
+    }
+    
+    bool openWebPDecoder(WebPDecodeSession& session) {
+        if (!configureWebPDecode(session.config, session.options, session.width, session.height,
+                                 session.channels)) {
+            return false;
+        }
+        if (session.pipeline &&
+            !beginStream(session.width, session.height, session.channels, *session.pipeline)) {
+            return false;
+        }
+        session.decoder = WebPIDecode(nullptr, 0, &session.config);
+        return session.decoder != nullptr;
+    }
+    
+    void configureWebP(WebPConfig& config, int quality, bool lossless, int method) {
+        WebPConfigInit(&config);
+        
+        const bool targeted = webpTargetSize > 0 || webpTargetPSNR > 0;
+        
+        config.quality = quality;
+        config.lossless = lossless;
+        config.method = method; // 6 = maximum compression
+        config.alpha_quality = quality;
+        config.alpha_compression = 1;
+        
+        // Advanced settings for better compression
+        config.sns_strength = 50;
+        config.filter_strength = 60;
+        config.filter_sharpness = 0;
+        config.filter_type = 1;
+        config.autofilter = 1;
+        config.pass = method >= 5 ? 6 : (targeted ? 3 : 1);
+        config.show_compressed = 0;
+        config.preprocessing = 0;
+        config.partitions = 0;
+        config.partition_limit = 0;
+        config.emulate_jpeg_size = 0;
+        config.thread_level = useMultithread ? 1 : 0;
+        config.low_memory = 0;
+        config.near_lossless = 100;
+        config.exact = 0;
+        config.use_delta_palette = 0;
+        config.use_sharp_yuv = webpSharpYUV || method >= 5;
+        
+        // Rate control: libwebp searches quality over `pass` passes
+        config.target_size = webpTargetSize;
+        config.target_PSNR = webpTargetPSNR;
+    }
+    
+    // Encode a populated picture; the caller keeps ownership of it
+    bool encodeWebPPicture(WebPPicture& picture, int quality, bool lossless, std::vector<uint8_t>& out) {
+        // Highest method that fits the budget for this mode and size
+        EncodeCostModel& cost = lossless ? webpLosslessCost
+                              : (webpTargetSize > 0 || webpTargetPSNR > 0) ? webpTargetedCost
+                              : webpLossyCost;
+        const size_t pixelCount = static_cast<size_t>(picture.width) * picture.height;
+        const int method = cost.choose(6, pixelCount, webpBudgetMs);
+        
+        WebPConfig config;
+        configureWebP(config, quality, lossless, method);
+        
+        // Encoded bytes go directly into the destination
+        picture.writer = writeToVector;
+        picture.custom_ptr = &out;
+        
+        // Encode
+        ScopedStage stage(profiler, ProfileStage::WebP, static_cast<double>(pixelCount));
+        const auto start = std::chrono::steady_clock::now();
+        bool ok = WebPEncode(&config, &picture);
+        if (ok) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            cost.record(method, pixelCount, elapsed.count());
+        } else {
+            out.clear();
+        }
+        
+        return ok;
+    }
+#else
+    // Built without libwebp: WebP requests fail like any other encode error
+    static WebPPicture* allocWebPPicture(int, int) {
+        return nullptr;
+    }
+    
+    static void freeWebPPicture(WebPPicture*) {}
+    
+    static uint32_t* webpRow(WebPPicture*, int) {
+        return nullptr;
+    }
+    
+    bool encodeWebPTo(std::vector<uint8_t>& out, int, bool) {
+        out.clear();
+        return false;
+    }
+    
+    bool encodeWebPPicture(WebPPicture&, int, bool, std::vector<uint8_t>& out) {
+        out.clear();
+        return false;
+    }
+    
+    bool encodeWebPPlanar(const PlanarImage&, int, std::vector<uint8_t>& out) {
+        out.clear();
+        return false;
+    }
+    
+    bool decodeWebP(const uint8_t*, size_t, const WebPDecodeOptions&) {
+        return false;
+    }
+    
+    int appendWebPDecode(WebPDecodeSession&, const uint8_t*, size_t) {
+        return -1;
+    }
+#endif
+    
+    // libwebp's own size and PSNR targets take precedence over ssimTarget
+    bool webpSSIMSearch() const {
+        return ssimTarget > 0 && webpTargetSize == 0 && webpTargetPSNR == 0;
+    }
+    
+    // AVIF encoding via libavif (see wasm-avif.h); lossy encodes search
+    // quality under an SSIM target
+    bool encodeAVIFTo(std::vector<uint8_t>& out, int quality) {
+        out.clear();
+        if (pixels == nullptr) return false;
+        if (ssimTarget <= 0 || quality >= 100) return encodeAVIFAt(out, quality);
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        const ssim::Plane reference = lumaPlane(sourceView(), arena);
+        const size_t rgbaStride = static_cast<size_t>(width) * 4;
+        uint8_t* rgba = arena.alloc<uint8_t>(rgbaStride * height);
+        
+        return encodeToSSIM(out, reference, quality, [&](std::vector<uint8_t>& dst, int trial, uint8_t* luma) {
+            if (!encodeAVIFAt(dst, trial)) return false;
+            if (luma == nullptr) return true;
+            {
+                ScopedStage stage(profiler, ProfileStage::Decode, static_cast<double>(width) * height);
+                if (!avif::decode(dst.data(), dst.size(), width, height, rgba, rgbaStride)) return false;
+            }
+            writeLuma({rgba, width, height, 4, rgbaStride}, luma, reference.stride);
+            return true;
+        });
+    }
+    
+    bool encodeAVIFAt(std::vector<uint8_t>& out, int quality) {
+        // Slowest preset that fits the budget, from measured throughput
+        const size_t pixelCount = static_cast<size_t>(width) * height;
+        avif::EncodeSettings settings = avifSettings;
+        settings.quality = quality;
+        const int level = avifCost.choose(avif::kFastestSpeed - avifSettings.speed, pixelCount, avifBudgetMs);
+        settings.speed = avif::kFastestSpeed - level;
+        settings.threads = (useMultithread && IMAGE_THREADS_AVAILABLE) ? numThreads : 1;
+        
+        ScopedStage stage(profiler, ProfileStage::AVIF, static_cast<double>(pixelCount));
+        const auto start = std::chrono::steady_clock::now();
+        const ImageView src = sourceView();
+        bool ok = avif::encode(src.data, src.width, src.height, src.channels, src.stride, settings, out);
+        if (ok) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            avifCost.record(level, pixelCount, elapsed.count());
+        }
+        
+        return ok;
+    }
+    
+    // JPEG XL encoding (simplified); searches quality under an SSIM target
+    bool encodeJPEGXLTo(std::vector<uint8_t>& out, int quality) {
+        out.clear();
+        if (pixels == nullptr) return false;
+        if (ssimTarget <= 0) return encodeJPEGXLAt(out, quality, nullptr);
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        const ssim::Plane reference = lumaPlane(sourceView(), arena);
+        uint8_t* frame = arena.alloc<uint8_t>(pixelBytes);
+        
+        return encodeToSSIM(out, reference, quality, [&](std::vector<uint8_t>& dst, int trial, uint8_t* luma) {
+            if (!encodeJPEGXLAt(dst, trial, luma != nullptr ? frame : nullptr)) return false;
+            if (luma == nullptr) return true;
+            writeLuma({frame, width, height, channels, sourceView().stride}, luma, reference.stride);
+            return true;
+        });
+    }
+    
+    // `reconstructed`, when set, receives the frame as a decoder would
+    // rebuild it: quantised and transformed, before lossless entropy coding
+    bool encodeJPEGXLAt(std::vector<uint8_t>& out, int quality, uint8_t* reconstructed) {
+        // Simplified JPEG XL implementation on a scratch copy of the frame
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        uint8_t* frame = arena.alloc<uint8_t>(pixelBytes);
+        const double pixelCount = static_cast<double>(width) * height;
+        {
+            ScopedStage stage(profiler, ProfileStage::Copy, pixelCount);
+            std::copy(pixels, pixels + pixelBytes, frame);
+        }
+        
+        // Apply modern compression techniques
+        {
+            ScopedStage stage(profiler, ProfileStage::Modular, pixelCount);
+            applyModularEncoding(frame, pixelBytes, quality);
+        }
+        {
+            ScopedStage stage(profiler, ProfileStage::DCT, pixelCount);
+            applyVarDCT(frame, pixelBytes);
+        }
+        if (reconstructed != nullptr) {
+            std::copy(frame, frame + pixelBytes, reconstructed);
+        }
+        {
+            ScopedStage stage(profiler, ProfileStage::Entropy, pixelCount);
+            applyEntropyEncoding(frame, pixelBytes, out);
+        }
+        
+        return true;
+    }
+    
+
+    // Advanced compression algorithms
+    template <int BlockSize>
+    void compressBlock(uint8_t* data, size_t size, int startX, int startY, float quality) {
+        // Apply DCT and quantization to the block
+        static_assert(BlockSize <= dct::kMaxSize, "block larger than the DCT tables");
+        float block[BlockSize * BlockSize] = {};
+        
+        // Extract block
+        for (int y = 0; y < BlockSize; y++) {
+            for (int x = 0; x < BlockSize; x++) {
+                const size_t idx = (static_cast<size_t>(startY + y) * width + (startX + x)) * channels;
+                if (idx < size) {
+                    block[y * BlockSize + x] = data[idx];
+                }
+            }
+        }
+        
+        // Apply 2D DCT
+        transformBlock<BlockSize, false>(block);
+        
+        // Quantization
+        for (int i = 0; i < BlockSize * BlockSize; i++) {
+            block[i] = std::round(block[i] * quality);
+        }
+        
+        // Inverse DCT
+        transformBlock<BlockSize, true>(block);
+        
+        // Put back
+        for (int y = 0; y < BlockSize; y++) {
+            for (int x = 0; x < BlockSize; x++) {
+                const size_t idx = (static_cast<size_t>(startY + y) * width + (startX + x)) * channels;
+                if (idx < size) {
+                    data[idx] = std::clamp(static_cast<int>(block[y * BlockSize + x]), 0, 255);
+                }
+            }
+        }
+    }
+    
+    // Forward/inverse 2D DCT of a size x size block, in place. Sizes 4-32
+    // use the factorized transforms; anything else takes the reference path.
+    void applyDCT2D(float* block, int size) {
+        switch (size) {
+            case 4: transformBlock<4, false>(block); return;
+            case 8: transformBlock<8, false>(block); return;
+            case 16: transformBlock<16, false>(block); return;
+            case 32: transformBlock<32, false>(block); return;
+        }
+        applyDCT2DReference(block, size);
+    }
+    
+    void applyInverseDCT2D(float* block, int size) {
+        switch (size) {
+            case 4: transformBlock<4, true>(block); return;
+            case 8: transformBlock<8, true>(block); return;
+            case 16: transformBlock<16, true>(block); return;
+            case 32: transformBlock<32, true>(block); return;
+        }
+        applyInverseDCT2DReference(block, size);
+    }
+    
+    template <int N, bool Inverse>
+    void transformBlock(float* block) {
+        if (dctMode == DCTMode::FixedPoint) {
+            constexpr float fraction = 1 << dct::kFixedFraction;
+            int32_t in[N * N];
+            int32_t out[N * N];
+            
+            if constexpr (Inverse) {
+                for (int i = 0; i < N * N; i++) in[i] = static_cast<int32_t>(std::lround(block[i] * fraction));
+                dct::inverseFixed2D<N>(in, out);
+                for (int i = 0; i < N * N; i++) block[i] = static_cast<float>(out[i]);
+            } else {
+                for (int i = 0; i < N * N; i++) in[i] = static_cast<int32_t>(std::lround(block[i]));
+                dct::forwardFixed2D<N>(in, out);
+                for (int i = 0; i < N * N; i++) block[i] = out[i] / fraction;
+            }
+            return;
+        }
+        
+        dct::transform2D<N, Inverse>(block, simdEnabled());
+    }
+    
+    // Direct O(N^4) 2D DCT, kept as the reference for the fast transforms
+    void applyDCT2DReference(float* block, int size) {
+        // Simplified 2D DCT implementation
+        if (size > dct::kMaxSize) return;
+        float temp[dct::kMaxSize * dct::kMaxSize];
+        const float pi = 3.14159265359f;
+        
+        for (int u = 0; u < size; u++) {
+            for (int v = 0; v < size; v++) {
+                float sum = 0.0f;
+                for (int x = 0; x < size; x++) {
+                    for (int y = 0; y < size; y++) {
+                        float cosX = std::cos(((2 * x + 1) * u * pi) / (2 * size));
+                        float cosY = std::cos(((2 * y + 1) * v * pi) / (2 * size));
+                        sum += block[y * size + x] * cosX * cosY;
+                    }
+                }
+                float cu = (u == 0) ? 1.0f / std::sqrt(2.0f) : 1.0f;
+                float cv = (v == 0) ? 1.0f / std::sqrt(2.0f) : 1.0f;
+                temp[v * size + u] = (cu * cv * 2.0f / size) * sum;
+            }
+        }
+        
+        std::copy(temp, temp + size * size, block);
+    }
+    
+    void applyInverseDCT2DReference(float* block, int size) {
+        // Simplified inverse 2D DCT
+        if (size > dct::kMaxSize) return;
+        float temp[dct::kMaxSize * dct::kMaxSize];
+        const float pi = 3.14159265359f;
+        
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                float sum = 0.0f;
+                for (int u = 0; u < size; u++) {
+                    for (int v = 0; v < size; v++) {
+                        float cu = (u == 0) ? 1.0f / std::sqrt(2.0f) : 1.0f;
+                        float cv = (v == 0) ? 1.0f / std::sqrt(2.0f) : 1.0f;
+                        float cosX = std::cos(((2 * x + 1) * u * pi) / (2 * size));
+                        float cosY = std::cos(((2 * y + 1) * v * pi) / (2 * size));
+                        sum += cu * cv * block[v * size + u] * cosX * cosY;
+                    }
+                }
+                temp[y * size + x] = sum * 2.0f / size;
+            }
+        }
+        
+        std::copy(temp, temp + size * size, block);
+    }
+    
+    // Predict each sample from its left neighbour (or the one above at the
+    // start of a row) and rANS-code the zigzagged residuals into `out`
+    void applyEntropyEncoding(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        const size_t rowBytes = static_cast<size_t>(width) * channels;
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        uint8_t* residuals = arena.alloc<uint8_t>(size);
+        
+        parallelFor(height, 64, [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const uint8_t* row = &data[y * rowBytes];
+                const uint8_t* above = y > 0 ? row - rowBytes : nullptr;
+                uint8_t* out = &residuals[y * rowBytes];
+                
+                for (size_t i = 0; i < rowBytes; i++) {
+                    int prediction = 0;
+                    if (i >= static_cast<size_t>(channels)) {
+                        prediction = row[i - channels];
+                    } else if (above) {
+                        prediction = above[i];
+                    }
+                    const int8_t r = static_cast<int8_t>(row[i] - prediction);
+                    out[i] = static_cast<uint8_t>(r >= 0 ? 2 * r : -2 * r - 1);
+                }
+            }
+        });
+        
+        out.reserve(size / 2);
+        rans::encode(residuals, size, out);
+    }
+    
+    void applyModularEncoding(uint8_t* data, size_t size, int quality) {
+        // Simplified modular encoding for JPEG XL
+        float threshold = (100 - quality) / 100.0f * 64.0f;
+        
+        for (size_t i = 0; i < size; i++) {
+            // Apply smart quantization
+            float value = data[i];
+            value = std::round(value / threshold) * threshold;
+            data[i] = std::clamp(static_cast<int>(value), 0, 255);
+        }
+    }
+    
+    // VarDCT partition: each 32x32 tile is split into quadrants while a
+    // block's variance exceeds kVarDCTSplitVariance, down to 4x4, so smooth
+    // areas get large transforms and detail small ones. Leaves above
+    // kVarDCTMinVariance are transformed.
+    static constexpr int kVarDCTMinSize = 4;
+    static constexpr int kVarDCTMaxLeaves = (TileSums::kSize / kVarDCTMinSize) * (TileSums::kSize / kVarDCTMinSize);
+    static constexpr float kVarDCTSplitVariance = 1600.0f;
+    static constexpr float kVarDCTMinVariance = 100.0f;
+    
+    struct VarDCTBlock {
+        int x, y;  // Within the tile
+        int size;
+        float variance;
+    };
+    
+    // Variable-size DCT blocks for better compression. One pass builds each
+    // tile's summed-area tables from the first channel; the tile's whole
+    // quadtree is decided from them before any of its blocks is transformed.
+    void applyVarDCT(uint8_t* data, size_t size) {
+        const int tile = TileSums::kSize;
+        const int tileRows = (height + tile - 1) / tile;
+        const int tileCols = (width + tile - 1) / tile;
+        const size_t stride = static_cast<size_t>(width) * channels;
+        
+        parallelFor(tileRows, 1, [&](int rowBegin, int rowEnd) {
+            TileSums sums;
+            VarDCTBlock leaves[kVarDCTMaxLeaves];
+            for (int ty = rowBegin; ty < rowEnd; ty++) {
+                const int y0 = ty * tile;
+                for (int tx = 0; tx < tileCols; tx++) {
+                    const int x0 = tx * tile;
+                    sums.build(data + y0 * stride + static_cast<size_t>(x0) * channels, stride, channels,
+                               std::min(tile, width - x0), std::min(tile, height - y0));
+                    const int count = partitionTile(sums, 0, 0, tile, leaves, 0);
+                    
+                    // Each size is its own instantiation, so block loops have constant bounds
+                    for (int i = 0; i < count; i++) {
+                        const VarDCTBlock& leaf = leaves[i];
+                        if (leaf.variance <= kVarDCTMinVariance) continue;
+                        const int x = x0 + leaf.x;
+                        const int y = y0 + leaf.y;
+                        switch (leaf.size) {
+                            case 4: compressBlock<4>(data, size, x, y, 0.8f); break;
+                            case 8: compressBlock<8>(data, size, x, y, 0.8f); break;
+                            case 16: compressBlock<16>(data, size, x, y, 0.8f); break;
+                            case 32: compressBlock<32>(data, size, x, y, 0.8f); break;
+                        }
+                    }
+                }
+            }
+        });
+    }
+    
+    // Append the leaves of the quadtree rooted at the size x size block at
+    // (x, y) to `leaves`, from index `count`; returns the new count. Blocks
+    // overhanging the frame edge are split until they fit, and 4x4 blocks
+    // that still overhang are left out.
+    static int partitionTile(const TileSums& sums, int x, int y, int size, VarDCTBlock* leaves, int count) {
+        const bool inside = x + size <= sums.width && y + size <= sums.height;
+        const float variance = inside ? sums.variance(x, y, size) : 0.0f;
+        if (inside && (size == kVarDCTMinSize || variance <= kVarDCTSplitVariance)) {
+            leaves[count++] = {x, y, size, variance};
+            return count;
+        }
+        if (size == kVarDCTMinSize) return count;
+        
+        const int half = size / 2;
+        count = partitionTile(sums, x, y, half, leaves, count);
+        count = partitionTile(sums, x + half, y, half, leaves, count);
+        count = partitionTile(sums, x, y + half, half, leaves, count);
+        return partitionTile(sums, x + half, y + half, half, leaves, count);
+    }
+
+public:
+    // Run a crop -> resize -> colour convert -> encode chain in one call.
+    // Pixels move between stages in strips of kPipelineStripRows rows; only
+    // encoders that need a whole frame (AVIF, JPEG XL, raw output) get one.
+    std::vector<uint8_t> runPipeline(const ImagePipeline& pipeline) {
+        std::vector<uint8_t> result;
+        runPipelineCached(result, pipeline);
+        return result;
+    }
+    
+    // Pipeline result in the output buffer; same lifetime rules as encodeWebPView
+    emscripten::val runPipelineView(const ImagePipeline& pipeline) {
+        prepareOutputBuffer();
+        runPipelineCached(outputBuffer, pipeline);
+        return outputView();
+    }
+    
+    // Streaming mode: run `pipeline` over a w x h source whose rows are
+    // pushed in order with pushRows, for sources too large to hold in the
+    // heap. Only a window of source rows sized to the vertical filter
+    // support is retained. Replaces any unfinished stream.
+    bool beginStream(int w, int h, int c, const ImagePipeline& pipeline) {
+        stream.reset();
+        if (w <= 0 || h <= 0 || c < 1 || c > kMaxChannels) return false;
+        
+        auto session = std::make_unique<RowStream>();
+        const ImageView source{nullptr, w, h, c, static_cast<size_t>(w) * c};
+        PipelineState& state = session->pipeline;
+        if (!planPipeline(pipeline, source, state.plan)) return false;
+        if (!openPipeline(state, session->pending, session->scratch)) return false;
+        
+        // Room for the widest filter window plus a strip of look-ahead, so
+        // output rows are produced in parallel batches rather than one by one
+        const ImageView& cropped = state.plan.source;
+        RowRing& ring = session->ring;
+        ring.width = cropped.width;
+        ring.height = cropped.height;
+        ring.channels = c;
+        ring.stride = static_cast<size_t>(cropped.width) * c;
+        ring.capacity = std::min(maxSourceWindow(state) + kPipelineStripRows, cropped.height);
+        ring.data.resize(ring.stride * ring.capacity);
+        
+        session->sourceWidth = w;
+        session->sourceHeight = h;
+        session->channels = c;
+        stream = std::move(session);
+        return true;
+    }
+    
+    // Push the next rowCount source rows (tightly packed). Returns the number
+    // of output rows completed so far, or -1 if there is no open stream.
+    int pushRows(uintptr_t dataPtr, size_t size, int rowCount) {
+        if (!stream) return -1;
+        RowStream& session = *stream;
+        const size_t rowBytes = static_cast<size_t>(session.sourceWidth) * session.channels;
+        rowCount = std::min(rowCount, session.sourceHeight - session.nextInput);
+        if (rowCount < 0 || size < frameBytes(session.sourceWidth, rowCount, session.channels)) return -1;
+        
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(dataPtr);
+        const PipelineState& state = session.pipeline;
+        const int cropY = state.plan.cropY;
+        const size_t cropOffset = static_cast<size_t>(state.plan.cropX) * session.channels;
+        RowRing& ring = session.ring;
+        
+        for (int i = 0; i < rowCount; i++) {
+            const int y = session.nextInput++ - cropY;
+            if (y < 0 || y >= ring.height || session.nextOutput >= state.plan.outHeight) continue;
+            
+            // Drain ready output rows before overwriting a row they still need
+            int first, last;
+            sourceWindow(state, session.nextOutput, first, last);
+            if (y >= ring.capacity && y - ring.capacity >= first) {
+                flushStream(session);
+            }
+            
+            std::memcpy(ring.row(y), data + i * rowBytes + cropOffset, ring.stride);
+            session.storedRows = y + 1;
+        }
+        
+        flushStream(session);
+        return session.nextOutput;
+    }
+    
+    // Raw output rows completed since the last call; drain these regularly
+    // so finished rows do not accumulate. Empty for encoded formats.
+    emscripten::val takeStreamRowsView() {
+        prepareOutputBuffer();
+        outputBuffer.clear();
+        if (stream) {
+            outputBuffer.swap(stream->pending);
+        }
+        return outputView();
+    }
+    
+    // End the stream and return the encoded image (or the remaining raw
+    // rows). Empty if not every source row was pushed.
+    emscripten::val finishStreamView() {
+        prepareOutputBuffer();
+        outputBuffer.clear();
+        if (stream && stream->nextOutput == stream->pipeline.plan.outHeight) {
+            closePipeline(stream->pipeline, outputBuffer);
+        }
+        stream.reset();
+        return outputView();
+    }
+    
+private:
+    using ConvertRowFn = void (*)(const uint8_t* src, uint8_t* dst, int count);
+    using PackRowFn = void (*)(const uint8_t* src, uint32_t* dst, int count);
+    
+    struct PipelinePlan {
+        ImageView source;  // After cropping
+        int cropX = 0;
+        int cropY = 0;
+        bool resize = false;
+        int outWidth = 0;
+        int outHeight = 0;
+        ResizeFilter filter = ResizeFilter::Lanczos;
+        std::vector<int> conversions;  // Channel count after each conversion
+        int outChannels = 0;
+        EncodeFormat format = EncodeFormat::Raw;
+        int quality = 80;
+        bool lossless = false;
+    };
+    
+    // Buffers and sink of one pipeline run, shared by the one-shot and
+    // streaming entry points
+    struct PipelineState {
+        PipelineState() = default;
+        
+        ~PipelineState() {
+            freeWebPPicture(picture);
+        }
+        
+        PipelineState(const PipelineState&) = delete;
+        PipelineState& operator=(const PipelineState&) = delete;
+        
+        PipelinePlan plan;
+        
+        // Final sink: WebP rows go straight into the encoder's ARGB plane,
+        // all other rows are appended to `rows`
+        bool webp = false;
+        WebPPicture* picture = nullptr;
+        std::vector<uint8_t>* rows = nullptr;
+        
+        // Owned, as a stream outlives any number of resizes that may evict
+        // them from the weight cache between pushes
+        std::shared_ptr<const ResampleWeights> horizontal;
+        std::shared_ptr<const ResampleWeights> vertical;
+        bool separable = false;
+        bool vectorize = false;
+        
+        // Row kernels for plan.conversions and the WebP sink
+        std::vector<ConvertRowFn> converters;
+        PackRowFn pack = nullptr;
+        
+        // Resampled strip at source channels, then per-row conversions;
+        // carved from the arena passed to openPipeline
+        uint8_t* strip = nullptr;
+        uint8_t* converted[2] = {};
+        size_t columnLength = 0;  // Floats per resample column
+    };
+    
+    struct RowStream {
+        ScratchArena scratch;  // Outlives every call of the session
+        PipelineState pipeline;
+        RowRing ring;
+        std::vector<uint8_t> pending;  // Raw rows not yet taken
+        int sourceWidth = 0;
+        int sourceHeight = 0;
+        int channels = 0;
+        int nextInput = 0;   // Next source row expected, before cropping
+        int storedRows = 0;  // Cropped rows received so far
+        int nextOutput = 0;
+    };
+    
+    // Validate stage order and resolve the geometry of every stage
+    bool planPipeline(const ImagePipeline& pipeline, const ImageView& source, PipelinePlan& plan) const {
+        plan.source = source;
+        plan.outChannels = source.channels;
+        bool encoded = false;
+        
+        for (const auto& stage : pipeline.getStages()) {
+            if (encoded) return false;  // Encode must be the last stage
+            
+            switch (stage.type) {
+                case ImagePipeline::StageType::Crop: {
+                    ImageView& view = plan.source;
+                    if (plan.resize) return false;
+                    if (stage.x < 0 || stage.y < 0 || stage.width <= 0 || stage.height <= 0 ||
+                        stage.x + stage.width > view.width || stage.y + stage.height > view.height) {
+                        return false;
+                    }
+                    plan.cropX += stage.x;
+                    plan.cropY += stage.y;
+                    view.width = stage.width;
+                    view.height = stage.height;
+                    break;
+                }
+                case ImagePipeline::StageType::Resize:
+                    if (plan.resize || stage.width <= 0 || stage.height <= 0) return false;
+                    plan.resize = true;
+                    plan.outWidth = stage.width;
+                    plan.outHeight = stage.height;
+                    plan.filter = parseResizeFilter(stage.name);
+                    break;
+                case ImagePipeline::StageType::ConvertColor:
+                    // Per-pixel channel maps commute with resampling, so they
+                    // run on output rows wherever they appear in the chain
+                    if (stage.channels < 1 || stage.channels > kMaxChannels) return false;
+                    plan.conversions.push_back(stage.channels);
+                    plan.outChannels = stage.channels;
+                    break;
+                case ImagePipeline::StageType::Encode:
+                    plan.format = parseEncodeFormat(stage.name);
+                    plan.quality = stage.quality;
+                    plan.lossless = stage.lossless;
+                    encoded = true;
+                    break;
+            }
+        }
+        
+        // Streaming plans have no pixels to point at
+        if (plan.source.data != nullptr) {
+            plan.source.data += static_cast<size_t>(plan.cropY) * source.stride +
+                                static_cast<size_t>(plan.cropX) * source.channels;
+        }
+        
+        if (!plan.resize) {
+            plan.outWidth = plan.source.width;
+            plan.outHeight = plan.source.height;
+        }
+        // Reject outputs too large to address at the most channels they pass through
+        return frameBytes(plan.outWidth, plan.outHeight, std::max(plan.outChannels, plan.source.channels)) != 0;
+    }
+    
+    bool runPipelineCached(std::vector<uint8_t>& out, const ImagePipeline& pipeline) {
+        ScopedStage stage(profiler, ProfileStage::Pipeline, static_cast<double>(width) * height);
+        
+        // Skip building the key when it would not be used
+        if (!encodeCacheActive()) {
+            return runPipelineTo(out, pipeline);
+        }
+        
+        return encodeCached(out, "pipeline" + pipelineCacheParams(pipeline), [&](std::vector<uint8_t>& dst) {
+            return runPipelineTo(dst, pipeline);
+        });
+    }
+    
+    std::string pipelineCacheParams(const ImagePipeline& pipeline) const {
+        std::string params;
+        for (const auto& stage : pipeline.getStages()) {
+            params += " " + std::to_string(static_cast<int>(stage.type)) + ":" +
+                      std::to_string(stage.x) + "," + std::to_string(stage.y) + "," +
+                      std::to_string(stage.width) + "," + std::to_string(stage.height) + "," +
+                      std::to_string(stage.channels) + "," + std::to_string(stage.quality) + "," +
+                      std::to_string(stage.lossless) + "," + stage.name;
+        }
+        return params + encoderCacheParams();
+    }
+    
+    bool runPipelineTo(std::vector<uint8_t>& out, const ImagePipeline& pipeline) {
+        out.clear();
+        if (pixels == nullptr) return false;
+        
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        PipelineState state;
+        if (!planPipeline(pipeline, sourceView(), state.plan)) return false;
+        
+        bool alpha = false;
+        if (usePlanarPipeline(state.plan, alpha)) {
+            const PipelinePlan& plan = state.plan;
+            PlanarImage planes = toPlanar(plan.source, arena, alpha);
+            if (plan.resize) {
+                PlanarImage resized = planar::allocate(arena, plan.outWidth, plan.outHeight, alpha);
+                resamplePlanar(planes, resized, plan.filter);
+                planes = resized;
+            }
+            return encodeWebPPlanar(planes, plan.quality, out);
+        }
+        
+        if (!openPipeline(state, out, arena)) return false;
+        
+        producePipelineRows(state, state.plan.source, 0, state.plan.outHeight);
+        return closePipeline(state, out);
+    }
+    
+    // Lossy WebP runs on YUV planes: the source is converted once and each
+    // plane resampled on its own, chroma at half resolution. Conversions to
+    // grey keep the row path, whose grey weights differ from BT.601 luma,
+    // and so does sharp YUV, which libwebp only applies to ARGB input.
+    // `alpha` is set when the output keeps an alpha channel.
+    bool usePlanarPipeline(const PipelinePlan& plan, bool& alpha) const {
+        if (!IMAGE_PROCESSOR_HAS_WEBP || plan.lossless || webpSharpYUV) return false;
+        if (plan.format != EncodeFormat::WebP) return false;
+        
+        const bool grey = plan.source.channels < 3;
+        alpha = plan.source.channels == 2 || plan.source.channels == 4;
+        for (int target : plan.conversions) {
+            if (target < 3 && !grey) return false;
+            alpha = alpha && (target == 2 || target == 4);
+        }
+        return true;
+    }
+    
+    // Set up the sink and the scratch buffers, which come from `arena`;
+    // raw rows are appended to rawOut
+    bool openPipeline(PipelineState& state, std::vector<uint8_t>& rawOut, ScratchArena& arena) {
+        const PipelinePlan& plan = state.plan;
+        const size_t outRowBytes = static_cast<size_t>(plan.outWidth) * plan.outChannels;
+        
+        // Lossy WebP under an SSIM target collects a frame for encodeWebPTo
+        const bool raw = plan.format == EncodeFormat::Raw;
+        state.webp = plan.format == EncodeFormat::WebP && (plan.lossless || !webpSSIMSearch());
+        if (state.webp) {
+            state.picture = allocWebPPicture(plan.outWidth, plan.outHeight);
+            if (state.picture == nullptr) return false;
+            state.pack = argbPacker(plan.outChannels);
+        } else {
+            state.rows = raw ? &rawOut : &pipelineFrame;
+            state.rows->clear();
+            state.rows->reserve(raw ? outRowBytes * kPipelineStripRows : outRowBytes * plan.outHeight);
+        }
+        
+        if (plan.resize) {
+            state.strip = arena.alloc<uint8_t>(static_cast<size_t>(plan.outWidth) * plan.source.channels *
+                                               kPipelineStripRows);
+        }
+        if (!plan.conversions.empty()) {
+            state.converters = rowConverters(plan.source.channels, plan.conversions);
+            state.converted[0] = arena.alloc<uint8_t>(static_cast<size_t>(plan.outWidth) * kMaxChannels);
+            state.converted[1] = arena.alloc<uint8_t>(static_cast<size_t>(plan.outWidth) * kMaxChannels);
+        }
+        
+        state.separable = isSeparable(plan.filter);
+        if (plan.resize && state.separable) {
+            state.horizontal = getResampleWeights(plan.source.width, plan.outWidth, plan.filter);
+            state.vertical = getResampleWeights(plan.source.height, plan.outHeight, plan.filter);
+            state.columnLength = resampleColumnLength(*state.horizontal, plan.source.channels);
+        }
+        state.vectorize = simdEnabled();
+        return true;
+    }
+    
+    // Source rows [first, last] that output row y reads
+    static void sourceWindow(const PipelineState& state, int y, int& first, int& last) {
+        if (!state.plan.resize) {
+            first = last = y;
+        } else if (state.separable) {
+            first = state.vertical->start[y];
+            last = first + state.vertical->count[y] - 1;
+        } else {
+            float dy;
+            bilinearSource(y, state.plan.source.height, state.plan.outHeight, first, last, dy);
+        }
+    }
+    
+    static int maxSourceWindow(const PipelineState& state) {
+        if (!state.plan.resize) return 1;
+        return state.separable ? state.vertical->maxTaps : 2;
+    }
+    
+    // Produce output rows [rowBegin, rowEnd) from `src` (an ImageView or a
+    // RowRing holding every row they read) and hand them to the sink
+    template <typename Rows>
+    void producePipelineRows(PipelineState& state, const Rows& src, int rowBegin, int rowEnd) {
+        const PipelinePlan& plan = state.plan;
+        const int outWidth = plan.outWidth;
+        const size_t stripRowBytes = static_cast<size_t>(outWidth) * src.channels;
+        const size_t outRowBytes = static_cast<size_t>(outWidth) * plan.outChannels;
+        
+        for (int y0 = rowBegin; y0 < rowEnd; y0 += kPipelineStripRows) {
+            const int y1 = std::min(y0 + kPipelineStripRows, rowEnd);
+            
+            const double stripPixels = static_cast<double>(y1 - y0) * outWidth;
+            if (plan.resize) {
+                ScopedStage stage(profiler, ProfileStage::Resize, stripPixels);
+                withChannels(src.channels, [&](auto channelCount) {
+                    constexpr int Channels = decltype(channelCount)::value;
+                    parallelFor(y1 - y0, 8, [&](int begin, int end) {
+                        uint8_t* dst = state.strip + begin * stripRowBytes;
+                        if (state.separable) {
+                            ScratchArena& arena = scratchArena();
+                            ScratchScope scope(arena);
+                            resampleRows<Channels>(src, arena.alloc<float>(state.columnLength), dst, stripRowBytes,
+                                                   y0 + begin, y0 + end, *state.horizontal, *state.vertical,
+                                                   state.vectorize);
+                        } else {
+                            bilinearRows<Channels>(src, dst, stripRowBytes, y0 + begin, y0 + end, outWidth,
+                                                   plan.outHeight);
+                        }
+                    });
+                });
+            }
+            
+            ScopedStage stage(profiler, ProfileStage::Convert, stripPixels);
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = plan.resize ? state.strip + (y - y0) * stripRowBytes : src.row(y);
+                for (size_t i = 0; i < state.converters.size(); i++) {
+                    uint8_t* dst = state.converted[i & 1];
+                    state.converters[i](row, dst, outWidth);
+                    row = dst;
+                }
+                
+                if (state.webp) {
+                    state.pack(row, webpRow(state.picture, y), outWidth);
+                } else {
+                    state.rows->insert(state.rows->end(), row, row + outRowBytes);
+                }
+            }
+        }
+    }
+    
+    // Encode the collected rows into `out`
+    bool closePipeline(PipelineState& state, std::vector<uint8_t>& out) {
+        const PipelinePlan& plan = state.plan;
+        
+        if (state.webp) {
+            return encodeWebPPicture(*state.picture, plan.quality, plan.lossless, out);
+        }
+        if (plan.format == EncodeFormat::Raw) {
+            if (state.rows != &out) {
+                out.swap(*state.rows);
+            }
+            return true;
+        }
+        
+        ScopedSource scope(*this, pipelineFrame.data(), pipelineFrame.size(),
+                           plan.outWidth, plan.outHeight, plan.outChannels);
+        if (plan.format == EncodeFormat::WebP) {
+            return encodeWebPTo(out, plan.quality, plan.lossless);
+        }
+        return plan.format == EncodeFormat::AVIF ? encodeAVIFTo(out, plan.quality)
+                                                 : encodeJPEGXLTo(out, plan.quality);
+    }
+    
+    // Emit every output row whose source window has fully arrived
+    void flushStream(RowStream& session) {
+        PipelineState& state = session.pipeline;
+        int end = session.nextOutput;
+        while (end < state.plan.outHeight) {
+            int first, last;
+            sourceWindow(state, end, first, last);
+            if (last >= session.storedRows) break;
+            end++;
+        }
+        
+        producePipelineRows(state, session.ring, session.nextOutput, end);
+        session.nextOutput = end;
+    }
+    
+    // Expand an interleaved pixel to RGBA; 1 and 2 channels are grey (+ alpha)
+    template <int Channels>
+    static void readRGBA(const uint8_t* p, uint8_t rgba[4]) {
+        if constexpr (Channels <= 2) {
+            rgba[0] = rgba[1] = rgba[2] = p[0];
+        } else {
+            rgba[0] = p[0];
+            rgba[1] = p[1];
+            rgba[2] = p[2];
+        }
+        if constexpr (Channels == 2 || Channels == 4) {
+            rgba[3] = p[Channels - 1];
+        } else {
+            rgba[3] = 255;
+        }
+    }
+    
+    template <int SrcChannels, int DstChannels>
+    static void convertRow(const uint8_t* src, uint8_t* dst, int count) {
+        if constexpr (SrcChannels == DstChannels) {
+            std::memcpy(dst, src, static_cast<size_t>(count) * DstChannels);
+            return;
+        }
+        
+        for (int x = 0; x < count; x++) {
+            uint8_t rgba[4];
+            readRGBA<SrcChannels>(src + x * SrcChannels, rgba);
+            uint8_t* p = dst + x * DstChannels;
+            if constexpr (DstChannels <= 2) {
+                // BT.601 luma
+                p[0] = static_cast<uint8_t>((77 * rgba[0] + 150 * rgba[1] + 29 * rgba[2] + 128) >> 8);
+                if constexpr (DstChannels == 2) p[1] = rgba[3];
+            } else {
+                p[0] = rgba[0];
+                p[1] = rgba[1];
+                p[2] = rgba[2];
+                if constexpr (DstChannels == 4) p[3] = rgba[3];
+            }
+        }
+    }
+    
+    template <int Channels>
+    static void packARGBRow(const uint8_t* src, uint32_t* dst, int count) {
+        for (int x = 0; x < count; x++) {
+            uint8_t rgba[4];
+            readRGBA<Channels>(src + x * Channels, rgba);
+            dst[x] = (uint32_t(rgba[3]) << 24) | (uint32_t(rgba[0]) << 16) |
+                     (uint32_t(rgba[1]) << 8) | rgba[2];
+        }
+    }
+    
+    // Row kernels for 1-4 channel counts, looked up once per call
+    static ConvertRowFn rowConverter(int srcChannels, int dstChannels) {
+        static constexpr ConvertRowFn kConverters[kMaxChannels][kMaxChannels] = {
+            {convertRow<1, 1>, convertRow<1, 2>, convertRow<1, 3>, convertRow<1, 4>},
+            {convertRow<2, 1>, convertRow<2, 2>, convertRow<2, 3>, convertRow<2, 4>},
+            {convertRow<3, 1>, convertRow<3, 2>, convertRow<3, 3>, convertRow<3, 4>},
+            {convertRow<4, 1>, convertRow<4, 2>, convertRow<4, 3>, convertRow<4, 4>},
+        };
+        return kConverters[srcChannels - 1][dstChannels - 1];
+    }
+    
+    static PackRowFn argbPacker(int channels) {
+        static constexpr PackRowFn kPackers[kMaxChannels] = {
+            packARGBRow<1>, packARGBRow<2>, packARGBRow<3>, packARGBRow<4>,
+        };
+        return kPackers[channels - 1];
+    }
+    
+    // One kernel per step of a conversion chain that starts at srcChannels
+    static std::vector<ConvertRowFn> rowConverters(int srcChannels, const std::vector<int>& conversions) {
+        std::vector<ConvertRowFn> kernels;
+        for (int target : conversions) {
+            kernels.push_back(rowConverter(srcChannels, target));
+            srcChannels = target;
+        }
+        return kernels;
+    }
+
+public:
+    // Image resizing with high-quality algorithms
+    std::vector<uint8_t> resize(int newWidth, int newHeight, const std::string& algorithm = "lanczos") {
+        const size_t bytes = frameBytes(newWidth, newHeight, channels);
+        if (pixels == nullptr || bytes == 0) return {};
+        
+        std::vector<uint8_t> resized(bytes);
+        resizeTo(resized.data(), newWidth, newHeight, parseResizeFilter(algorithm));
+        
+        return resized;
+    }
+    
+    // Resize into a caller-owned buffer of at least newWidth * newHeight * channels bytes
+    bool resizeInto(uintptr_t dstPtr, size_t dstSize, int newWidth, int newHeight,
+                    const std::string& algorithm) {
+        const size_t bytes = frameBytes(newWidth, newHeight, channels);
+        if (pixels == nullptr || bytes == 0 || dstSize < bytes) return false;
+        
+        resizeTo(reinterpret_cast<uint8_t*>(dstPtr), newWidth, newHeight, parseResizeFilter(algorithm));
+        return true;
+    }
+    
+    // Resize into the output buffer; same lifetime rules as encodeWebPView
+    emscripten::val resizeView(int newWidth, int newHeight, const std::string& algorithm) {
+        prepareOutputBuffer();
+        outputBuffer.clear();
+        const size_t bytes = frameBytes(newWidth, newHeight, channels);
+        if (pixels != nullptr && bytes != 0) {
+            outputBuffer.resize(bytes);
+            resizeTo(outputBuffer.data(), newWidth, newHeight, parseResizeFilter(algorithm));
+        }
+        return outputView();
+    }
+    
+    // Responsive variants (srcset widths) of the current source in one call.
+    // `pipeline` supplies the crop, colour conversions and encode stage; a
+    // resize stage only names the filter (lanczos without one). Heights keep
+    // the cropped aspect ratio. Results follow the order of `widths`, and a
+    // variant that fails comes back empty.
+    std::vector<std::vector<uint8_t>> generateVariants(const ImagePipeline& pipeline,
+                                                       const std::vector<int>& widths) {
+        std::vector<std::vector<uint8_t>> results(widths.size());
+        buildVariants(pipeline, widths, results);
+        return results;
+    }
+    
+    // Variants back to back in the output buffer, returned as an array of
+    // views in the order of `widths`; same lifetime rules as encodeWebPView
+    emscripten::val generateVariantsView(const ImagePipeline& pipeline, const std::vector<int>& widths) {
+        prepareOutputBuffer();
+        std::vector<std::vector<uint8_t>> results(widths.size());
+        buildVariants(pipeline, widths, results);
+        
+        size_t total = 0;
+        for (const auto& result : results) total += result.size();
+        outputBuffer.clear();
+        outputBuffer.reserve(total);
+        for (const auto& result : results) {
+            outputBuffer.insert(outputBuffer.end(), result.begin(), result.end());
+        }
+        
+        emscripten::val views = emscripten::val::array();
+        size_t offset = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            views.set(i, emscripten::val(emscripten::typed_memory_view(results[i].size(),
+                                                                       outputBuffer.data() + offset)));
+            offset += results[i].size();
+        }
+        return views;
+    }
+    
+private:
+    // A level is resampled from an earlier (larger) level only when that is
+    // at least this much wider; closer levels would stack two filters' blur
+    // for little saving, so they go back to the source
+    static constexpr double kCascadeRatio = 1.25;
+    
+    // Variants are built largest first. Each one is resampled from the
+    // smallest level already built that is at least kCascadeRatio times its
+    // width, so the full-size source is usually read once, for the largest.
+    // Colour conversion runs only on levels taken from the source, since the
+    // others inherit converted pixels. Lossy WebP levels are YUV planes
+    // converted from the source once (see usePlanarPipeline). All levels are
+    // then encoded in parallel.
+    bool buildVariants(const ImagePipeline& pipeline, const std::vector<int>& widths,
+                       std::vector<std::vector<uint8_t>>& results) {
+        if (pixels == nullptr) return false;
+        
+        PipelinePlan plan;
+        if (!planPipeline(pipeline, sourceView(), plan)) return false;
+        const ImageView& source = plan.source;
+        const ResizeFilter filter = plan.resize ? plan.filter : ResizeFilter::Lanczos;
+        
+        ScopedStage stage(profiler, ProfileStage::Variants, static_cast<double>(source.width) * source.height);
+        ScratchArena& arena = scratchArena();
+        ScratchScope scope(arena);
+        
+        std::vector<int> order(widths.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<int>(i);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return widths[a] > widths[b]; });
+        
+        bool alpha = false;
+        const bool planarLevels = usePlanarPipeline(plan, alpha);
+        PlanarImage planarSource;
+        if (planarLevels) {
+            planarSource = toPlanar(source, arena, alpha);
+        }
+        
+        // Interleaved or planar; data / y stays null for invalid widths
+        std::vector<ImageView> levels(widths.size());
+        std::vector<PlanarImage> planes(widths.size());
+        std::vector<int> built;  // Level indices, widest first
+        for (int index : order) {
+            const int w = widths[index];
+            if (w <= 0) continue;
+            const int h = std::max(1, static_cast<int>(std::lround(static_cast<double>(w) * source.height /
+                                                                   source.width)));
+            
+            // The last match is the smallest, as levels are built widest first.
+            // Upscaled levels hold nothing the source does not.
+            int parent = -1;
+            for (int b : built) {
+                if (widths[b] < source.width && widths[b] >= kCascadeRatio * w) parent = b;
+            }
+            built.push_back(index);
+            
+            if (planarLevels) {
+                planes[index] = planar::allocate(arena, w, h, alpha);
+                resamplePlanar(parent >= 0 ? planes[parent] : planarSource, planes[index], filter);
+                continue;
+            }
+            
+            ImageView& level = levels[index];
+            level.width = w;
+            level.height = h;
+            level.channels = plan.outChannels;
+            level.stride = static_cast<size_t>(w) * plan.outChannels;
+            uint8_t* data = arena.alloc<uint8_t>(level.stride * h);
+            
+            if (parent >= 0) {
+                resampleView(levels[parent], data, level.stride, w, h, filter);
+            } else if (plan.conversions.empty()) {
+                resampleView(source, data, level.stride, w, h, filter);
+            } else {
+                ScratchScope temp(arena);
+                const size_t resizedStride = static_cast<size_t>(w) * source.channels;
+                uint8_t* resized = arena.alloc<uint8_t>(resizedStride * h);
+                resampleView(source, resized, resizedStride, w, h, filter);
+                convertFrame(resized, source.channels, data, plan.conversions, w, h, arena);
+            }
+            level.data = data;
+        }
+        
+        // Encoded variants are cached under the loaded source, not the level
+        std::vector<std::string> keys(widths.size());
+        if (encodeCacheActive() && plan.format != EncodeFormat::Raw) {
+            const std::string params = "variant " + pipelineCacheParams(pipeline);
+            for (size_t i = 0; i < widths.size(); i++) {
+                keys[i] = sourceCacheKey(params + " w=" + std::to_string(widths[i]));
+            }
+        }
+        
+        encodeVariants(plan, levels, planes, keys, results);
+        return true;
+    }
+    
+    // Run a chain of channel conversions over a packed w x h frame
+    void convertFrame(const uint8_t* src, int srcChannels, uint8_t* dst, const std::vector<int>& conversions,
+                      int w, int h, ScratchArena& arena) {
+        ScopedStage stage(profiler, ProfileStage::Convert, static_cast<double>(w) * h);
+        ScratchScope scope(arena);
+        uint8_t* temp[2] = {arena.alloc<uint8_t>(static_cast<size_t>(w) * kMaxChannels),
+                            arena.alloc<uint8_t>(static_cast<size_t>(w) * kMaxChannels)};
+        const size_t srcRowBytes = static_cast<size_t>(w) * srcChannels;
+        const size_t dstRowBytes = static_cast<size_t>(w) * conversions.back();
+        const std::vector<ConvertRowFn> converters = rowConverters(srcChannels, conversions);
+        
+        for (int y = 0; y < h; y++) {
+            const uint8_t* row = src + y * srcRowBytes;
+            for (size_t i = 0; i < converters.size(); i++) {
+                uint8_t* out = i + 1 == converters.size() ? dst + y * dstRowBytes : temp[i & 1];
+                converters[i](row, out, w);
+                row = out;
+            }
+        }
+    }
+    
+    // Encode every level on its own encoder processor, one per pool
+    // participant, so concurrent encodes share no source or scratch state.
+    // keys[i] is level i's encode cache key, or empty to skip the cache.
+    void encodeVariants(const PipelinePlan& plan, const std::vector<ImageView>& levels,
+                        const std::vector<PlanarImage>& planes, const std::vector<std::string>& keys,
+                        std::vector<std::vector<uint8_t>>& results) {
+        if (plan.format == EncodeFormat::Raw) {
+            for (size_t i = 0; i < levels.size(); i++) {
+                if (levels[i].data == nullptr) continue;
+                results[i].assign(levels[i].data, levels[i].data + levels[i].stride * levels[i].height);
+            }
+            return;
+        }
+        
+        // The pool, once created, has numThreads participants
+        while (variantEncoders.size() < static_cast<size_t>(std::max(numThreads, 1))) {
+            auto encoder = std::make_unique<ImageProcessor>();
+            encoder->shareEncodeCache(*this);
+            encoder->setThreading(false, 1);
+            variantEncoders.push_back(std::move(encoder));
+        }
+        
+        const ProcessorSettings settings = getSettings();
+        ImagePipeline encode;
+        encode.encode(encodeFormatName(plan.format), plan.quality, plan.lossless);
+        parallelFor(static_cast<int>(levels.size()), 1, [&](int begin, int end) {
+            ImageProcessor& encoder = *variantEncoders[ThreadPool::currentParticipant()];
+            encoder.applySettings(settings);
+            for (int i = begin; i < end; i++) {
+                const ImageView& level = levels[i];
+                if (level.data == nullptr && planes[i].y == nullptr) continue;
+                if (!keys[i].empty()) {
+                    const bool hit = encodeCache->lookup(keys[i], results[i]);
+                    encoder.profiler.recordCacheLookup(hit);
+                    if (hit) continue;
+                }
+                
+                bool ok;
+                if (planes[i].y != nullptr) {
+                    ok = encoder.encodeWebPPlanar(planes[i], plan.quality, results[i]);
+                } else {
+                    encoder.setSource(level.data, level.stride * level.height, level.width, level.height,
+                                      level.channels);
+                    ok = encoder.runPipelineTo(results[i], encode);
+                }
+                if (ok && !keys[i].empty() && !results[i].empty()) {
+                    encodeCache->insert(keys[i], results[i]);
+                }
+            }
+            encoder.setSource(nullptr, 0, 0, 0, 0);
+        });
+        
+        for (auto& encoder : variantEncoders) {
+            profiler.merge(encoder->profiler);
+            encoder->profiler.reset();
+        }
+    }
+    
+    // YUV 4:2:0 copy of `src` in `arena`, with an alpha plane if requested
+    PlanarImage toPlanar(const ImageView& src, ScratchArena& arena, bool alpha) {
+        ScopedStage stage(profiler, ProfileStage::Convert, static_cast<double>(src.width) * src.height);
+        PlanarImage planes = planar::allocate(arena, src.width, src.height, alpha);
+        parallelFor((src.height + 1) / 2, 8, [&](int pairBegin, int pairEnd) {
+            planar::fromInterleaved(src.data, src.stride, src.channels, planes, pairBegin, pairEnd);
+        });
+        return planes;
+    }
+    
+    // Resample each plane of `src` to the size of `dst`; chroma stays at
+    // half resolution
+    void resamplePlanar(const PlanarImage& src, PlanarImage& dst, ResizeFilter filter) {
+        auto plane = [](const uint8_t* data, int w, int h, size_t stride) {
+            return ImageView{data, w, h, 1, stride};
+        };
+        resampleView(plane(src.y, src.width, src.height, src.yStride), dst.y, dst.yStride,
+                     dst.width, dst.height, filter);
+        resampleView(plane(src.u, src.chromaWidth(), src.chromaHeight(), src.uvStride), dst.u, dst.uvStride,
+                     dst.chromaWidth(), dst.chromaHeight(), filter);
+        resampleView(plane(src.v, src.chromaWidth(), src.chromaHeight(), src.uvStride), dst.v, dst.uvStride,
+                     dst.chromaWidth(), dst.chromaHeight(), filter);
+        if (src.a != nullptr && dst.a != nullptr) {
+            resampleView(plane(src.a, src.width, src.height, src.yStride), dst.a, dst.yStride,
+                         dst.width, dst.height, filter);
+        }
+    }
+    
+    void resizeTo(uint8_t* output, int newWidth, int newHeight, ResizeFilter filter) {
+        const size_t dstRowBytes = static_cast<size_t>(newWidth) * channels;
+        resampleView(sourceView(), output, dstRowBytes, newWidth, newHeight, filter);
+    }
+    
+    // Resample `src` into a newWidth x newHeight frame at `output` whose rows
+    // are dstRowBytes apart
+    void resampleView(const ImageView& src, uint8_t* output, size_t dstRowBytes, int newWidth, int newHeight,
+                      ResizeFilter filter) {
+        ScopedStage stage(profiler, ProfileStage::Resize, static_cast<double>(newWidth) * newHeight);
+        
+        if (isSeparable(filter)) {
+            // Fetching the vertical table may evict the horizontal one from the cache
+            const std::shared_ptr<const ResampleWeights> horizontalTable =
+                getResampleWeights(src.width, newWidth, filter);
+            const std::shared_ptr<const ResampleWeights> verticalTable =
+                getResampleWeights(src.height, newHeight, filter);
+            const ResampleWeights& horizontal = *horizontalTable;
+            const ResampleWeights& vertical = *verticalTable;
+            const bool vectorize = simdEnabled();
+            const size_t columnLength = resampleColumnLength(horizontal, src.channels);
+            
+            withChannels(src.channels, [&](auto channelCount) {
+                constexpr int Channels = decltype(channelCount)::value;
+                parallelFor(newHeight, 8, [&](int rowBegin, int rowEnd) {
+                    ScratchArena& arena = scratchArena();
+                    ScratchScope scope(arena);
+                    resampleRows<Channels>(src, arena.alloc<float>(columnLength), output + rowBegin * dstRowBytes,
+                                           dstRowBytes, rowBegin, rowEnd, horizontal, vertical, vectorize);
+                });
+            });
+        } else {
+            withChannels(src.channels, [&](auto channelCount) {
+                constexpr int Channels = decltype(channelCount)::value;
+                parallelFor(newHeight, 16, [&](int rowBegin, int rowEnd) {
+                    bilinearRows<Channels>(src, output + rowBegin * dstRowBytes, dstRowBytes, rowBegin, rowEnd,
+                                           newWidth, newHeight);
+                });
+            });
+        }
+    }
+    
+    static bool isSeparable(ResizeFilter filter) {
+        return filter == ResizeFilter::Lanczos || filter == ResizeFilter::Bicubic;
+    }
+    
+    // Call fn(std::integral_constant<int, C>()) for the channel count C of
+    // a 1-4 channel frame, so kernels are instantiated per channel count and
+    // the choice is made once per call rather than per pixel
+    template <typename Fn>
+    static void withChannels(int channels, Fn&& fn) {
+        switch (channels) {
+            case 1: fn(std::integral_constant<int, 1>()); return;
+            case 2: fn(std::integral_constant<int, 2>()); return;
+            case 3: fn(std::integral_constant<int, 3>()); return;
+            default: fn(std::integral_constant<int, 4>()); return;
+        }
+    }
+    
+    // Floats in the column buffer of resampleRows: one source row, padded so
+    // vector loads may run past the last pixel's taps
+    static size_t resampleColumnLength(const ResampleWeights& horizontal, int channels) {
+        return static_cast<size_t>(horizontal.srcSize + horizontal.maxTaps + 1) * channels;
+    }
+    
+    // Column floats one tile of output columns may span in resampleRows.
+    // Neighbouring tiles both accumulate the maxTaps pixels under their
+    // shared edge, so tiles also span kResampleTileOverlap times that: on
+    // large downscales, where maxTaps is wide, that bounds the repeated
+    // vertical work to about 1/8 rather than letting it exceed the tile.
+    static constexpr int kResampleTileFloats = 4096;
+    static constexpr int kResampleTileOverlap = 8;
+    
+    // End of the tile of output columns starting at xBegin: as many as fit
+    // their source span in the tile budget, and at least one
+    static int resampleTileEnd(const ResampleWeights& horizontal, int xBegin, int channels) {
+        const int budget = std::max(kResampleTileFloats / channels, kResampleTileOverlap * horizontal.maxTaps);
+        const int limit = horizontal.start[xBegin] + budget - horizontal.maxTaps;
+        int xEnd = xBegin + 1;
+        while (xEnd < horizontal.dstSize && horizontal.start[xEnd] <= limit) xEnd++;
+        return xEnd;
+    }
+    
+    // Separable resize of output rows [rowBegin, rowEnd): vertical pass over
+    // contiguous source rows into `column` (resampleColumnLength floats),
+    // then the horizontal pass. `dst` points at output row rowBegin.
+    //
+    // Wide frames go a tile of output columns at a time, each reading only
+    // its span of the source rows, so the span of `column` and the source
+    // rows under the vertical taps stay in cache from one output row to the
+    // next. Spans start on whole vectors of the row, so each sample is
+    // accumulated exactly as it would be in a full-width pass.
+    template <int Channels, typename Rows>
+    static void resampleRows(const Rows& src, float* column, uint8_t* dst, size_t dstStride,
+                             int rowBegin, int rowEnd, const ResampleWeights& horizontal,
+                             const ResampleWeights& vertical, bool vectorize) {
+        const int srcRowLength = src.width * Channels;
+        
+        for (int xBegin = 0; xBegin < horizontal.dstSize;) {
+            const int xEnd = resampleTileEnd(horizontal, xBegin, Channels);
+            const int spanBegin = horizontal.start[xBegin] * Channels / simd::kLanes * simd::kLanes;
+            const int spanEnd = (horizontal.start[xEnd - 1] + horizontal.maxTaps) * Channels;
+            const int rowSpanEnd = std::min((spanEnd + simd::kLanes - 1) / simd::kLanes * simd::kLanes,
+                                            srcRowLength);
+            
+            // Taps past the last source pixel read zeros
+            if (spanEnd > rowSpanEnd) std::fill(column + rowSpanEnd, column + spanEnd, 0.0f);
+            
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const float* wy = &vertical.weights[static_cast<size_t>(y) * vertical.maxTaps];
+                std::fill(column + spanBegin, column + rowSpanEnd, 0.0f);
+                
+                for (int t = 0; t < vertical.count[y]; t++) {
+                    accumulateRow(column + spanBegin, src.row(vertical.start[y] + t) + spanBegin,
+                                  rowSpanEnd - spanBegin, wy[t], vectorize);
+                }
+                
+                filterRow<Channels>(column, dst + (y - rowBegin) * dstStride, horizontal, xBegin, xEnd, vectorize);
+            }
+            xBegin = xEnd;
+        }
+    }
+    
+    // column[i] += row[i] * weight
+    static void accumulateRow(float* column, const uint8_t* row, int length, float weight, bool vectorize) {
+        int i = 0;
+        if (vectorize) {
+            simd::VecF w = simd::splat(weight);
+            for (; i + simd::kLanes <= length; i += simd::kLanes) {
+                simd::store(&column[i], simd::madd(simd::load(&column[i]), simd::loadU8(row + i), w));
+            }
+        }
+        for (; i < length; i++) {
+            column[i] += row[i] * weight;
+        }
+    }
+    
+    // Horizontal pass over output columns [xBegin, xEnd) of one float row.
+    // In the vector path multi-channel pixels map to the four lanes directly;
+    // single-channel rows take four taps per step against the zero-padded
+    // weight table.
+    template <int Channels>
+    static void filterRow(const float* column, uint8_t* dstRow, const ResampleWeights& horizontal,
+                          int xBegin, int xEnd, bool vectorize) {
+        if (Channels != 2 && vectorize) {
+            for (int x = xBegin; x < xEnd; x++) {
+                const float* wx = &horizontal.weights[x * horizontal.maxTaps];
+                const float* src = column + horizontal.start[x] * Channels;
+                const int taps = horizontal.count[x];
+                
+                if constexpr (Channels == 1) {
+                    simd::F32x4 acc = simd::zero4();
+                    for (int t = 0; t < taps; t += 4) {
+                        acc = simd::madd(acc, simd::load4(src + t), simd::load4(wx + t));
+                    }
+                    dstRow[x] = std::clamp(static_cast<int>(simd::hsum(acc) + 0.5f), 0, 255);
+                    continue;
+                }
+                
+                simd::F32x4 acc = simd::zero4();
+                for (int t = 0; t < taps; t++) {
+                    acc = simd::madd(acc, simd::load4(src + t * Channels), simd::splat4(wx[t]));
+                }
+                
+                if constexpr (Channels == 4) {
+                    simd::storeU8x4(dstRow + x * 4, acc);
+                } else {
+                    uint8_t pixel[4];
+                    simd::storeU8x4(pixel, acc);
+                    std::memcpy(dstRow + x * 3, pixel, 3);
+                }
+            }
+            return;
+        }
+        
+        for (int x = xBegin; x < xEnd; x++) {
+            const float* wx = &horizontal.weights[x * horizontal.maxTaps];
+            const float* src = &column[horizontal.start[x] * Channels];
+            
+            float acc[Channels] = {};
+            for (int t = 0; t < horizontal.count[x]; t++) {
+                for (int c = 0; c < Channels; c++) {
+                    acc[c] += src[t * Channels + c] * wx[t];
+                }
+            }
+            for (int c = 0; c < Channels; c++) {
+                dstRow[x * Channels + c] = std::clamp(static_cast<int>(acc[c] + 0.5f), 0, 255);
+            }
+        }
+    }
+    
+    std::shared_ptr<const ResampleWeights> getResampleWeights(int srcSize, int dstSize, ResizeFilter filter) {
+        for (const auto& cached : weightCache) {
+            if (cached->srcSize == srcSize && cached->dstSize == dstSize && cached->filter == filter) {
+                return cached;
+            }
+        }
+        
+        if (weightCache.size() >= kMaxCachedWeights) {
+            weightCache.erase(weightCache.begin());
+        }
+        weightCache.push_back(std::make_shared<const ResampleWeights>(
+            buildResampleWeights(srcSize, dstSize, filter)));
+        return weightCache.back();
+    }
+    
+    static ResampleWeights buildResampleWeights(int srcSize, int dstSize, ResizeFilter filter) {
+        const bool lanczos = filter == ResizeFilter::Lanczos;
+        const float radius = lanczos ? 3.0f : 2.0f;
+        
+        // Widen the kernel on downscale so every source sample contributes
+        const float scale = static_cast<float>(srcSize) / dstSize;
+        const float filterScale = std::max(scale, 1.0f);
+        const float support = radius * filterScale;
+        
+        ResampleWeights table;
+        table.srcSize = srcSize;
+        table.dstSize = dstSize;
+        table.filter = filter;
+        // Rounded up to whole vectors; unused taps keep a zero weight
+        table.maxTaps = (static_cast<int>(std::ceil(support)) * 2 + 1 + 3) & ~3;
+        table.start.resize(dstSize);
+        table.count.resize(dstSize);
+        table.weights.assign(static_cast<size_t>(dstSize) * table.maxTaps, 0.0f);
+        
+        for (int i = 0; i < dstSize; i++) {
+            // Map pixel centres, then clip the window to the source
+            const float center = (i + 0.5f) * scale - 0.5f;
+            int first = std::max(static_cast<int>(std::ceil(center - support)), 0);
+            int last = std::min(static_cast<int>(std::floor(center + support)), srcSize - 1);
+            last = std::min(last, first + table.maxTaps - 1);
+            
+            float* w = &table.weights[static_cast<size_t>(i) * table.maxTaps];
+            float total = 0.0f;
+            for (int j = first; j <= last; j++) {
+                const float x = (j - center) / filterScale;
+                w[j - first] = lanczos ? lanczosKernel<3>(x) : cubicWeight(x);
+                total += w[j - first];
+            }
+            
+            if (total != 0.0f) {
+                for (int t = 0; t <= last - first; t++) w[t] /= total;
+            }
+            table.start[i] = first;
+            table.count[i] = last - first + 1;
+        }
+        
+        return table;
+    }
+    
+    template <int Lobes>
+    static float lanczosKernel(float x) {
+        if (x == 0) return 1.0f;
+        if (std::abs(x) >= Lobes) return 0.0f;
+        
+        const float pi = 3.14159265359f;
+        float pix = pi * x;
+        return Lobes * std::sin(pix) * std::sin(pix / Lobes) / (pix * pix);
+    }
+    
+    static float cubicWeight(float x) {
+        x = std::abs(x);
+        if (x <= 1.0f) {
+            return 1.5f * x * x * x - 2.5f * x * x + 1.0f;
+        } else if (x < 2.0f) {
+            return -0.5f * x * x * x + 2.5f * x * x - 4.0f * x + 2.0f;
+        }
+        return 0.0f;
+    }
+    
+    // Source rows and blend factor of bilinear output row y
+    static void bilinearSource(int y, int srcHeight, int newHeight, int& y0, int& y1, float& dy) {
+        float srcY = newHeight > 1 ? (float)y * (srcHeight - 1) / (newHeight - 1) : 0.0f;
+        y0 = static_cast<int>(srcY);
+        y1 = std::min(y0 + 1, srcHeight - 1);
+        dy = srcY - y0;
+    }
+    
+    // Fast bilinear interpolation of output rows [rowBegin, rowEnd)
+    template <int Channels, typename Rows>
+    static void bilinearRows(const Rows& src, uint8_t* dst, size_t dstStride, int rowBegin, int rowEnd,
+                             int newWidth, int newHeight) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            int y0, y1;
+            float dy;
+            bilinearSource(y, src.height, newHeight, y0, y1, dy);
+            
+            const uint8_t* row0 = src.row(y0);
+            const uint8_t* row1 = src.row(y1);
+            uint8_t* dstRow = dst + (y - rowBegin) * dstStride;
+            
+            for (int x = 0; x < newWidth; x++) {
+                float srcX = newWidth > 1 ? (float)x * (src.width - 1) / (newWidth - 1) : 0.0f;
+                int x0 = static_cast<int>(srcX);
+                int x1 = std::min(x0 + 1, src.width - 1);
+                float dx = srcX - x0;
+                
+                for (int c = 0; c < Channels; c++) {
+                    float p00 = row0[x0 * Channels + c];
+                    float p01 = row0[x1 * Channels + c];
+                    float p10 = row1[x0 * Channels + c];
+                    float p11 = row1[x1 * Channels + c];
+                    
+                    float p0 = p00 * (1 - dx) + p01 * dx;
+                    float p1 = p10 * (1 - dx) + p11 * dx;
+                    float result = p0 * (1 - dy) + p1 * dy;
+                    
+                    dstRow[x * Channels + c] = std::clamp(static_cast<int>(result), 0, 255);
+                }
+            }
+        }
+    }
+};
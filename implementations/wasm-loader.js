@@ -3,8 +3,10 @@ class WASMImageProcessor {
   constructor() {
     this.module = null;
     this.processor = null;
+    this.scheduler = null;
     this.isLoaded = false;
     this.loadingPromise = null;
+    this.memory64 = false;
     this.performanceMetrics = {
       loadTime: 0,
       processingTime: 0,
@@ -25,6 +27,8 @@ class WASMImageProcessor {
     const startTime = performance.now();
     
     try {
+      this.memory64 = this.wantsMemory64(options);
+      
       // Progressive loading - check for cached version first
       const cachedModule = await this.loadFromCache();
       if (cachedModule) {
@@ -37,6 +41,8 @@ class WASMImageProcessor {
 
       // Initialize processor instance
       this.processor = new this.module.ImageProcessor();
+      this.configureProcessor(options);
+      await this.restoreEncodeCache();
       
       this.performanceMetrics.loadTime = performance.now() - startTime;
       this.isLoaded = true;
@@ -54,10 +60,80 @@ class WASMImageProcessor {
     }
   }
 
+  configureProcessor(options = {}) {
+    // Match the processor's worker pool to the variant that was loaded
+    const features = this.detectWASMFeatures();
+    if (this.processor.setThreading) {
+      const threads = Math.min(navigator.hardwareConcurrency || 4, 8);
+      this.processor.setThreading(features.threads, features.threads ? threads : 1);
+    }
+    
+    // Encoded results are reused across identical requests
+    const { encodeCacheBytes = 64 * 1024 * 1024 } = options;
+    this.processor.setEncodeCacheLimit(encodeCacheBytes);
+  }
+
+  // The encode cache survives reloads as a single blob in IndexedDB
+  openCacheDatabase() {
+    return new Promise((resolve, reject) => {
+      const request = indexedDB.open('wasm-image-processor', 1);
+      request.onupgradeneeded = () => request.result.createObjectStore('encode-cache');
+      request.onsuccess = () => resolve(request.result);
+      request.onerror = () => reject(request.error);
+    });
+  }
+
+  async restoreEncodeCache() {
+    if (typeof indexedDB === 'undefined') return;
+    
+    try {
+      const db = await this.openCacheDatabase();
+      const blob = await new Promise((resolve, reject) => {
+        const request = db.transaction('encode-cache').objectStore('encode-cache').get('blob');
+        request.onsuccess = () => resolve(request.result);
+        request.onerror = () => reject(request.error);
+      });
+      db.close();
+      if (!blob) return;
+      
+      const bytes = new Uint8Array(blob);
+      const dataPtr = this.allocateMemory(bytes.length);
+      new Uint8Array(this.module.instance.exports.memory.buffer).set(bytes, dataPtr);
+      this.processor.importEncodeCache(dataPtr, bytes.length);
+      this.deallocateMemory(dataPtr);
+    } catch (error) {
+      console.warn('Encode cache restore failed:', error);
+    }
+  }
+
+  async persistEncodeCache() {
+    if (!this.isLoaded || typeof indexedDB === 'undefined') return;
+    
+    try {
+      // Copy out of the WASM heap before the next call reuses the buffer
+      const blob = this.processor.exportEncodeCacheView().slice().buffer;
+      const db = await this.openCacheDatabase();
+      await new Promise((resolve, reject) => {
+        const tx = db.transaction('encode-cache', 'readwrite');
+        tx.objectStore('encode-cache').put(blob, 'blob');
+        tx.oncomplete = resolve;
+        tx.onerror = () => reject(tx.error);
+      });
+      db.close();
+    } catch (error) {
+      console.warn('Encode cache persist failed:', error);
+    }
+  }
+
+  getEncodeCacheStats() {
+    return this.processor ? this.processor.getEncodeCacheStats() : null;
+  }
+
   async loadFromCache() {
     try {
+      // Cached per variant, so a module built for other features is never reused
       const cache = await caches.open('wasm-modules-v1');
-      const response = await cache.match('/wasm/image-processor.wasm');
+      const response = await cache.match(this.selectOptimalWASMFile());
       
       if (response) {
         const wasmBytes = await response.arrayBuffer();
@@ -95,11 +171,23 @@ class WASMImageProcessor {
     return module;
   }
 
+  // The memory64 variants lift the 4 GB limit of wasm32 for gigapixel
+  // inputs. They are opt-in (options.memory64), as 64-bit addresses cost
+  // some speed, and the build must include them (IMAGE_PROCESSOR_WASM_MEMORY64).
+  wantsMemory64(options = {}) {
+    const features = this.detectWASMFeatures();
+    return Boolean(options.memory64) && features.memory64 && features.simd;
+  }
+
   selectOptimalWASMFile() {
     // Select WASM file based on browser capabilities
     const features = this.detectWASMFeatures();
     
-    if (features.simd && features.threads) {
+    if (this.memory64) {
+      return features.threads
+        ? '/wasm/image-processor-simd-threads-64.wasm'
+        : '/wasm/image-processor-simd-64.wasm';
+    } else if (features.simd && features.threads) {
       return '/wasm/image-processor-simd-threads.wasm';
     } else if (features.simd) {
       return '/wasm/image-processor-simd.wasm';
@@ -115,7 +203,8 @@ class WASMImageProcessor {
       simd: false,
       threads: false,
       bulkMemory: false,
-      multiValue: false
+      multiValue: false,
+      memory64: false
     };
 
     try {
@@ -148,17 +237,38 @@ class WASMImageProcessor {
       features.bulkMemory = false;
     }
 
+    // Check memory64: a module with one i64-addressed memory
+    try {
+      features.memory64 = WebAssembly.validate(new Uint8Array([
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        0x05, 0x03, 0x01, 0x04, 0x01
+      ]));
+    } catch (e) {
+      features.memory64 = false;
+    }
+
     return features;
   }
 
   createImportObject(options) {
+    const initial = options.initialMemory || 256;
+    const shared = this.detectWASMFeatures().threads;
+    
     return {
       env: {
-        memory: new WebAssembly.Memory({ 
-          initial: options.initialMemory || 256,
-          maximum: options.maxMemory || 2048,
-          shared: this.detectWASMFeatures().threads
-        }),
+        // Page counts of an i64 memory are BigInts; allow up to 16 GB
+        memory: this.memory64
+          ? new WebAssembly.Memory({
+              address: 'i64',
+              initial: BigInt(initial),
+              maximum: BigInt(options.maxMemory || 262144),
+              shared
+            })
+          : new WebAssembly.Memory({
+              initial,
+              maximum: options.maxMemory || 2048,
+              shared
+            }),
         
         // Math functions
         sin: Math.sin,
@@ -202,7 +312,7 @@ class WASMImageProcessor {
       const cache = await caches.open('wasm-modules-v1');
       const wasmUrl = this.selectOptimalWASMFile();
       const response = await fetch(wasmUrl);
-      await cache.put('/wasm/image-processor.wasm', response);
+      await cache.put(wasmUrl, response);
     } catch (error) {
       console.warn('Failed to cache WASM module:', error);
     }
@@ -220,9 +330,10 @@ class WASMImageProcessor {
       const memory = new Uint8Array(this.module.instance.exports.memory.buffer);
       memory.set(testData, dataPtr);
       
-      // Load and process test image
-      this.processor.loadImage(dataPtr, testData.length, 64, 64, 4);
-      const result = this.processor.encodeWebP(80);
+      // Load and process test image; keep it out of the encode cache
+      this.processor.loadImageView(dataPtr, testData.length, 64, 64, 4);
+      this.processor.setEncodeCacheEnabled(false);
+      this.processor.encodeWebPView(80, false);
       
       // Clean up
       this.deallocateMemory(dataPtr);
@@ -241,15 +352,9 @@ class WASMImageProcessor {
     const startTime = performance.now();
     
     try {
-      const {
-        format = 'auto',
-        quality = 80,
-        resize = null,
-        networkSpeed = 10,
-        devicePixelRatio = window.devicePixelRatio || 1,
-        batteryLevel = 100,
-        preferQuality = false
-      } = options;
+      // trace: true records this request's stages as Chrome trace-event
+      // JSON (result.trace), loadable in Perfetto
+      const { useCache = true, trace = false } = options;
 
       // Analyze image
       const { width, height, channels } = this.analyzeImageData(imageData);
@@ -259,35 +364,29 @@ class WASMImageProcessor {
       const memory = new Uint8Array(this.module.instance.exports.memory.buffer);
       memory.set(new Uint8Array(imageData), dataPtr);
       
-      // Load image into processor
-      this.processor.loadImage(dataPtr, imageData.length, width, height, channels);
+      // Let the processor borrow the pixels rather than copying them again
+      this.processor.loadImageView(dataPtr, imageData.length, width, height, channels);
+      
+      const selectedFormat = this.selectFormat(options);
+      this.applyEncoderOptions(selectedFormat, options);
+      const pipeline = this.buildPipeline(selectedFormat, options);
       
-      // Resize if needed
-      let processedData;
-      if (resize) {
-        const resizeAlgorithm = this.selectResizeAlgorithm(resize.width, resize.height, options);
-        processedData = this.processor.resize(resize.width, resize.height, resizeAlgorithm);
+      // Encoded output lands in the processor's output buffer
+      this.processor.setEncodeCacheEnabled(useCache);
+      if (trace) {
+        this.processor.setTracing(true);
       }
+      const view = this.processor.runPipelineView(pipeline);
+      pipeline.delete();
       
-      // Select optimal format
-      const selectedFormat = format === 'auto' 
-        ? this.processor.selectOptimalFormat(networkSpeed, devicePixelRatio, batteryLevel, preferQuality)
-        : format;
+      // The view aliases the WASM heap and is reused by the next call, so
+      // move the bytes out before anything else touches the module
+      const result = view.slice();
       
-      // Encode image
-      let result;
-      switch (selectedFormat) {
-        case 'webp':
-          result = this.processor.encodeWebP(quality, options.lossless || false);
-          break;
-        case 'avif':
-          result = this.processor.encodeAVIF(quality);
-          break;
-        case 'jpegxl':
-          result = this.processor.encodeJPEGXL(quality);
-          break;
-        default:
-          result = this.processor.encodeWebP(quality);
+      let traceJSON = null;
+      if (trace) {
+        traceJSON = this.processor.getTrace();
+        this.processor.setTracing(false);
       }
       
       // Clean up memory
@@ -311,7 +410,8 @@ class WASMImageProcessor {
         originalSize: imageData.length,
         compressedSize: result.length,
         compressionRatio,
-        processingTime
+        processingTime,
+        trace: traceJSON
       };
       
     } catch (error) {
@@ -320,6 +420,172 @@ class WASMImageProcessor {
     }
   }
 
+  // srcset variants of one image in a single call: { width, data } per
+  // entry of `widths`. Smaller widths are resampled from larger ones and
+  // the encodes run in parallel inside the module. options.filter picks
+  // the resampling filter ('lanczos' by default).
+  async generateVariants(imageData, widths, options = {}) {
+    if (!this.isLoaded) {
+      await this.initialize();
+    }
+    
+    const { width, height, channels } = this.analyzeImageData(imageData);
+    const dataPtr = this.allocateMemory(imageData.length);
+    const memory = new Uint8Array(this.module.instance.exports.memory.buffer);
+    memory.set(new Uint8Array(imageData), dataPtr);
+    this.processor.loadImageView(dataPtr, imageData.length, width, height, channels);
+    
+    const selectedFormat = this.selectFormat(options);
+    this.applyEncoderOptions(selectedFormat, options);
+    const { quality = 80, filter = 'lanczos' } = options;
+    const pipeline = new this.module.ImagePipeline();
+    pipeline.resize(width, height, filter);  // Only the filter is used
+    pipeline.encode(selectedFormat, quality, selectedFormat === 'webp' && (options.lossless || false));
+    
+    const widthList = new this.module.VectorInt();
+    widths.forEach(w => widthList.push_back(w));
+    
+    try {
+      const views = this.processor.generateVariantsView(pipeline, widthList);
+      
+      // Views alias the output buffer; copy them out before the next call
+      return widths.map((w, i) => ({ width: w, format: selectedFormat, data: views[i].slice() }));
+    } finally {
+      widthList.delete();
+      pipeline.delete();
+      this.deallocateMemory(dataPtr);
+    }
+  }
+
+  // Re-encode an existing WebP without a JS-side decode. options.resize
+  // and options.crop ({ x, y, width, height }) are applied by the decoder,
+  // so thumbnails of large files skip most of the pixel work. `source` is
+  // the file's bytes or a ReadableStream of them (e.g. a fetch body in the
+  // service worker); streamed files are decoded and encoded as chunks arrive.
+  async processWebP(source, options = {}) {
+    if (!this.isLoaded) {
+      await this.initialize();
+    }
+    
+    const { crop = {}, resize = null } = options;
+    const decodeOptions = {
+      cropX: crop.x || 0,
+      cropY: crop.y || 0,
+      cropWidth: crop.width || 0,
+      cropHeight: crop.height || 0,
+      width: resize ? resize.width || 0 : 0,
+      height: resize ? resize.height || 0 : 0
+    };
+    
+    const selectedFormat = this.selectFormat(options);
+    this.applyEncoderOptions(selectedFormat, options);
+    // The decoder has already scaled the frame
+    const pipeline = this.buildPipeline(selectedFormat, { ...options, resize: null });
+    
+    try {
+      let view;
+      if (source instanceof ReadableStream) {
+        if (!this.processor.beginWebPDecodeStream(decodeOptions, pipeline)) {
+          throw new Error('WebP decoding is not available');
+        }
+        const reader = source.getReader();
+        for (;;) {
+          const { done, value } = await reader.read();
+          if (done) break;
+          this.appendWebPChunk(value);
+        }
+        if (!this.processor.finishWebPDecode()) {
+          throw new Error('WebP stream ended before the image was complete');
+        }
+        view = this.processor.finishStreamView();
+      } else {
+        const bytes = new Uint8Array(source);
+        const dataPtr = this.allocateMemory(bytes.length);
+        new Uint8Array(this.module.instance.exports.memory.buffer).set(bytes, dataPtr);
+        const ok = this.processor.loadWebP(dataPtr, bytes.length, decodeOptions);
+        this.deallocateMemory(dataPtr);
+        if (!ok) {
+          throw new Error('WebP decode failed');
+        }
+        view = this.processor.runPipelineView(pipeline);
+      }
+      
+      // The view aliases the WASM heap; copy it out before the next call
+      return { data: view.slice(), format: selectedFormat };
+    } finally {
+      pipeline.delete();
+    }
+  }
+
+  // Feed one chunk of a streamed WebP to the incremental decoder
+  appendWebPChunk(chunk) {
+    const dataPtr = this.allocateMemory(chunk.length);
+    new Uint8Array(this.module.instance.exports.memory.buffer).set(chunk, dataPtr);
+    const rows = this.processor.appendWebPData(dataPtr, chunk.length);
+    this.deallocateMemory(dataPtr);
+    if (rows < 0) {
+      throw new Error('WebP decode failed');
+    }
+  }
+
+  // Requested format, or the best one for the client when 'auto'; AVIF
+  // needs a build with libavif linked in
+  selectFormat(options) {
+    const {
+      format = 'auto',
+      networkSpeed = 10,
+      devicePixelRatio = window.devicePixelRatio || 1,
+      batteryLevel = 100,
+      preferQuality = false
+    } = options;
+    
+    let selectedFormat = format === 'auto' 
+      ? this.processor.selectOptimalFormat(networkSpeed, devicePixelRatio, batteryLevel, preferQuality)
+      : format;
+    if (selectedFormat === 'avif' && !this.processor.isAVIFAvailable()) {
+      selectedFormat = 'webp';
+    }
+    return selectedFormat;
+  }
+
+  applyEncoderOptions(selectedFormat, options) {
+    // targetSSIM (MS-SSIM, e.g. 0.98) turns quality into a ceiling: each
+    // lossy image gets the lowest quality that still reaches it
+    this.processor.setSSIMTarget(options.targetSSIM || 0);
+    
+    // Per-request WebP deadline and byte/PSNR targets (0 = unconstrained)
+    if (selectedFormat === 'webp') {
+      const { webpBudgetMs = 0, targetSize = 0, targetPSNR = 0 } = options;
+      this.processor.setWebPTargets(webpBudgetMs, targetSize, targetPSNR);
+      
+      // sharpYUV: libwebp's slower RGB to YUV conversion, which keeps
+      // saturated edges in graphics and text sharper
+      this.processor.setSharpYUV(options.sharpYUV || false);
+    }
+    
+    // Per-request AVIF effort: faster presets are used when the predicted
+    // encode time would overrun avifBudgetMs
+    if (selectedFormat === 'avif') {
+      const { avifSpeed = 6, avifTileRowsLog2 = -1, avifTileColsLog2 = -1, avifBudgetMs = 0 } = options;
+      this.processor.setAVIFOptions(avifSpeed, avifTileRowsLog2, avifTileColsLog2, avifBudgetMs);
+    }
+  }
+
+  // Resize and encode in one pass; the resized frame never leaves WASM.
+  // The caller deletes the returned pipeline.
+  buildPipeline(selectedFormat, options) {
+    const { quality = 80, resize = null } = options;
+    const pipeline = new this.module.ImagePipeline();
+    if (resize) {
+      const resizeAlgorithm = this.selectResizeAlgorithm(resize.width, resize.height, options);
+      pipeline.resize(resize.width, resize.height, resizeAlgorithm);
+    }
+    
+    const lossless = selectedFormat === 'webp' && (options.lossless || false);
+    pipeline.encode(selectedFormat, quality, lossless);
+    return pipeline;
+  }
+
   analyzeImageData(imageData) {
     // Simple image analysis - in real scenario, use proper image headers
     const dataLength = imageData.length;
@@ -353,34 +619,94 @@ class WASMImageProcessor {
       throw new Error('WASM module not loaded or malloc not available');
     }
     
+    // Raw memory64 exports take and return addresses as BigInt
+    if (this.memory64) {
+      return Number(this.module.instance.exports.malloc(BigInt(size)));
+    }
     return this.module.instance.exports.malloc(size);
   }
 
   deallocateMemory(ptr) {
     if (this.module && this.module.instance.exports.free) {
-      this.module.instance.exports.free(ptr);
+      this.module.instance.exports.free(this.memory64 ? BigInt(ptr) : ptr);
     }
   }
 
-  // Batch processing for multiple images
+  // Batch processing for multiple images. Each image runs on its own
+  // worker processor in the module; options.lanes[i] puts image i in lane
+  // 0 (visible), 1 (near the viewport, the default) or 2 (background), and
+  // options.onResult(result, i) fires as soon as image i is done.
   async processBatch(images, options = {}) {
-    const results = [];
-    const batchSize = options.batchSize || 4;
-    
-    // Process in batches to avoid memory issues
-    for (let i = 0; i < images.length; i += batchSize) {
-      const batch = images.slice(i, i + batchSize);
-      const batchPromises = batch.map(imageData => 
-        this.processImage(imageData, { ...options, useCache: true })
-      );
+    if (!this.isLoaded) {
+      await this.initialize();
+    }
+    
+    const { lanes = null, onResult = null, workers = 0 } = options;
+    if (!this.scheduler) {
+      this.scheduler = new this.module.BatchScheduler(this.processor, workers);
+    }
+    
+    // Jobs copy the processor's settings when submitted
+    const selectedFormat = this.selectFormat(options);
+    this.applyEncoderOptions(selectedFormat, options);
+    this.processor.setEncodeCacheEnabled(true);
+    const pipeline = this.buildPipeline(selectedFormat, options);
+    
+    const startTime = performance.now();
+    const results = new Array(images.length).fill(null);
+    const pending = new Map();
+    
+    try {
+      images.forEach((imageData, index) => {
+        const { width, height, channels } = this.analyzeImageData(imageData);
+        const dataPtr = this.allocateMemory(imageData.length);
+        const memory = new Uint8Array(this.module.instance.exports.memory.buffer);
+        memory.set(new Uint8Array(imageData), dataPtr);
+        
+        const lane = lanes ? lanes[index] : 1;
+        const id = this.scheduler.submit(dataPtr, imageData.length, width, height, channels, pipeline, lane);
+        if (id < 0) {
+          this.deallocateMemory(dataPtr);
+          return;
+        }
+        pending.set(id, { index, dataPtr, originalSize: imageData.length });
+      });
+    } finally {
+      pipeline.delete();
+    }
+    
+    // Poll without blocking the main thread; results arrive in completion order
+    while (pending.size > 0) {
+      const id = this.scheduler.nextResult();
+      if (id < 0) {
+        await new Promise(resolve => setTimeout(resolve, 0));
+        continue;
+      }
       
-      const batchResults = await Promise.all(batchPromises);
-      results.push(...batchResults);
+      const job = pending.get(id);
+      pending.delete(id);
+      const ok = this.scheduler.resultOk(id);
+      const data = ok ? this.scheduler.resultView(id).slice() : null;
+      this.scheduler.releaseResult(id);
+      this.deallocateMemory(job.dataPtr);
       
-      // Allow other tasks to run
-      await new Promise(resolve => setTimeout(resolve, 0));
+      const result = ok ? {
+        data,
+        format: selectedFormat,
+        originalSize: job.originalSize,
+        compressedSize: data.length,
+        compressionRatio: job.originalSize / data.length,
+        processingTime: performance.now() - startTime
+      } : null;
+      results[job.index] = result;
+      if (onResult) {
+        onResult(result, job.index);
+      }
     }
     
+    // Keep this session's encodes for the next one
+    await this.persistEncodeCache();
+    
     return results;
   }
 
@@ -390,6 +716,8 @@ class WASMImageProcessor {
       ...this.performanceMetrics,
       isLoaded: this.isLoaded,
       memoryUsage: this.getMemoryUsage(),
+      scratchMemory: this.processor ? this.processor.getScratchStats() : null,
+      stages: this.processor ? this.processor.getStats() : null,
       features: this.detectWASMFeatures()
     };
   }
@@ -404,6 +732,11 @@ class WASMImageProcessor {
 
   // Clean up resources
   dispose() {
+    if (this.scheduler) {
+      this.scheduler.delete();
+      this.scheduler = null;
+    }
+    
     if (this.processor) {
       // Call destructor if available
       if (this.processor.destructor) {
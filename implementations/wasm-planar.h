@@ -0,0 +1,119 @@
+// Planar YUV 4:2:0 frames for the lossy WebP path
+//
+// VP8 codes luma at full resolution and chroma at half resolution in both
+// directions. Converting to that layout once, before any resampling, lets
+// the resize kernels work on 1.5 planes (2.5 with alpha) instead of 3-4
+// interleaved channels. libwebp then takes the planes as they are, rather
+// than converting an ARGB picture on every encode.
+//
+// Planes are carved from a ScratchArena, and every row starts on a 64-byte
+// cache line.
+#pragma once
+
+#include "wasm-scratch-arena.h"
+#include "wasm-simd.h"
+
+#include <cstring>
+
+struct PlanarImage {
+    int width = 0;
+    int height = 0;
+    uint8_t* y = nullptr;
+    uint8_t* u = nullptr;
+    uint8_t* v = nullptr;
+    uint8_t* a = nullptr;  // Null when opaque
+    size_t yStride = 0;    // Also the alpha stride
+    size_t uvStride = 0;
+
+    int chromaWidth() const {
+        return (width + 1) / 2;
+    }
+
+    int chromaHeight() const {
+        return (height + 1) / 2;
+    }
+};
+
+namespace planar {
+
+constexpr size_t kRowAlignment = 64;
+
+inline size_t alignedStride(int width) {
+    return (static_cast<size_t>(width) + kRowAlignment - 1) & ~(kRowAlignment - 1);
+}
+
+inline uint8_t* allocPlane(ScratchArena& arena, size_t bytes) {
+    uint8_t* p = arena.alloc<uint8_t>(bytes + kRowAlignment - ScratchArena::kAlignment);
+    const uintptr_t aligned = (reinterpret_cast<uintptr_t>(p) + kRowAlignment - 1) & ~(kRowAlignment - 1);
+    return reinterpret_cast<uint8_t*>(aligned);
+}
+
+// Uninitialized width x height frame; `alpha` adds a full-resolution plane
+inline PlanarImage allocate(ScratchArena& arena, int width, int height, bool alpha) {
+    PlanarImage image;
+    image.width = width;
+    image.height = height;
+    image.yStride = alignedStride(width);
+    image.uvStride = alignedStride(image.chromaWidth());
+    image.y = allocPlane(arena, image.yStride * height);
+    image.u = allocPlane(arena, image.uvStride * image.chromaHeight());
+    image.v = allocPlane(arena, image.uvStride * image.chromaHeight());
+    if (alpha) {
+        image.a = allocPlane(arena, image.yStride * height);
+    }
+    return image;
+}
+
+// BT.601 luma of one row of an interleaved frame with 1-4 channels
+inline void lumaRow(const uint8_t* row, int width, int channels, uint8_t* luma) {
+    if (channels >= 3) {
+        simd::lumaRow(row, width, channels, luma);
+        return;
+    }
+    for (int x = 0; x < width; x++) {
+        const int g = row[x * channels];
+        luma[x] = simd::luma(g, g, g);
+    }
+}
+
+// Convert source rows [2 * pairBegin, 2 * pairEnd) of an interleaved frame
+// with 1-4 channels into `dst`, which has the same size. Each pair of rows
+// makes one chroma row; odd edges reuse their last row or column. Alpha is
+// copied only when dst has an alpha plane.
+inline void fromInterleaved(const uint8_t* src, size_t srcStride, int channels, PlanarImage& dst,
+                            int pairBegin, int pairEnd) {
+    const int width = dst.width;
+    const bool colour = channels >= 3;
+
+    for (int pair = pairBegin; pair < pairEnd; pair++) {
+        const int y0 = pair * 2;
+        const int y1 = std::min(y0 + 1, dst.height - 1);
+        const uint8_t* row0 = src + y0 * srcStride;
+        const uint8_t* row1 = src + y1 * srcStride;
+
+        for (int y = y0; y <= y1; y++) {
+            const uint8_t* row = y == y0 ? row0 : row1;
+            lumaRow(row, width, channels, dst.y + y * dst.yStride);
+
+            if (dst.a != nullptr) {
+                uint8_t* alpha = dst.a + y * dst.yStride;
+                if (channels == 2 || channels == 4) {
+                    for (int x = 0; x < width; x++) alpha[x] = row[x * channels + channels - 1];
+                } else {
+                    std::memset(alpha, 255, width);
+                }
+            }
+        }
+
+        uint8_t* u = dst.u + pair * dst.uvStride;
+        uint8_t* v = dst.v + pair * dst.uvStride;
+        if (!colour) {
+            std::memset(u, 128, dst.chromaWidth());
+            std::memset(v, 128, dst.chromaWidth());
+            continue;
+        }
+        simd::chromaRow(row0, row1, width, channels, u, v);
+    }
+}
+
+} // namespace planar
@@ -0,0 +1,207 @@
+// Always-on stage timing for ImageProcessor, with optional trace capture
+//
+// Each instrumented stage adds its wall time and pixel count to a fixed
+// table: two clock reads per stage and no allocation. Parallel regions also
+// add the time their participants spent busy, which gives thread
+// utilisation, and encode cache lookups are counted as hits or misses.
+// With tracing switched on, every stage is also kept as a Chrome
+// trace-event "complete" event. traceJSON() renders those events for
+// Perfetto or chrome://tracing.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class ProfileStage : int {
+    Copy,      // loadImage and the JPEG XL working frame
+    Decode,    // loadWebP and incremental WebP decode
+    Hash,      // Source hashing for the encode cache
+    Resize,
+    Convert,   // Colour conversion and encoder row packing
+    Modular,   // JPEG XL quantisation
+    DCT,       // JPEG XL VarDCT
+    Entropy,   // JPEG XL prediction + rANS
+    WebP,
+    AVIF,
+    Analyze,   // Content analysis (analyzeImage, content-aware format choice)
+    SSIM,      // Multi-scale SSIM, including SSIM-targeted quality searches
+    Pipeline,  // Whole runPipeline call, including the stages above
+    Variants,  // Whole generateVariants call
+    Count
+};
+
+constexpr int kProfileStageCount = static_cast<int>(ProfileStage::Count);
+
+constexpr const char* kProfileStageNames[kProfileStageCount] = {
+    "copy", "decode", "hash", "resize", "convert", "modular",
+    "dct", "entropy", "webp", "avif", "analyze", "ssim", "pipeline", "variants",
+};
+
+struct StageTotals {
+    uint32_t calls = 0;
+    double ms = 0;
+    double pixels = 0;
+};
+
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Oldest events are kept; later ones are counted as dropped
+    static constexpr size_t kMaxTraceEvents = 1 << 16;
+
+    void record(ProfileStage stage, Clock::time_point start, Clock::time_point end, double pixels) {
+        const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        StageTotals& total = totals[static_cast<int>(stage)];
+        total.calls++;
+        total.ms += ms;
+        total.pixels += pixels;
+
+        if (!tracing) return;
+        if (events.size() >= kMaxTraceEvents) {
+            droppedEvents++;
+            return;
+        }
+        events.push_back({stage, microseconds(start), microseconds(end) - microseconds(start), pixels});
+    }
+
+    // One parallel region: wall time, summed busy time of its chunks, and
+    // how many threads could have run them
+    void recordParallel(double wallMs, double busyMs, int participants) {
+        parallelWallMs += wallMs;
+        parallelBusyMs += busyMs;
+        parallelCapacityMs += wallMs * participants;
+    }
+
+    void recordCacheLookup(bool hit) {
+        (hit ? cacheHits : cacheMisses)++;
+    }
+
+    // Add another profiler's counters, e.g. a helper processor's; its trace
+    // events are not copied
+    void merge(const Profiler& other) {
+        for (int i = 0; i < kProfileStageCount; i++) {
+            totals[i].calls += other.totals[i].calls;
+            totals[i].ms += other.totals[i].ms;
+            totals[i].pixels += other.totals[i].pixels;
+        }
+        parallelWallMs += other.parallelWallMs;
+        parallelBusyMs += other.parallelBusyMs;
+        parallelCapacityMs += other.parallelCapacityMs;
+        cacheHits += other.cacheHits;
+        cacheMisses += other.cacheMisses;
+    }
+
+    const StageTotals& stage(ProfileStage stage) const {
+        return totals[static_cast<int>(stage)];
+    }
+
+    double getParallelWallMs() const {
+        return parallelWallMs;
+    }
+
+    double getParallelBusyMs() const {
+        return parallelBusyMs;
+    }
+
+    uint32_t getCacheHits() const {
+        return cacheHits;
+    }
+
+    uint32_t getCacheMisses() const {
+        return cacheMisses;
+    }
+
+    // Busy share of the thread time available inside parallel regions
+    double getUtilisation() const {
+        return parallelCapacityMs > 0 ? parallelBusyMs / parallelCapacityMs : 0.0;
+    }
+
+    void reset() {
+        for (StageTotals& total : totals) total = StageTotals();
+        parallelWallMs = 0;
+        parallelBusyMs = 0;
+        parallelCapacityMs = 0;
+        cacheHits = 0;
+        cacheMisses = 0;
+        events.clear();
+        droppedEvents = 0;
+    }
+
+    // Starting a trace discards the events of the previous one
+    void setTracing(bool enabled) {
+        if (enabled && !tracing) {
+            events.clear();
+            droppedEvents = 0;
+        }
+        tracing = enabled;
+    }
+
+    bool isTracing() const {
+        return tracing;
+    }
+
+    // {"traceEvents": [...]} with one "X" event per recorded stage
+    std::string traceJSON() const {
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        char event[256];
+        for (size_t i = 0; i < events.size(); i++) {
+            const TraceEvent& e = events[i];
+            std::snprintf(event, sizeof(event),
+                          "%s{\"name\":\"%s\",\"cat\":\"image\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                          "\"ts\":%lld,\"dur\":%lld,\"args\":{\"pixels\":%.0f}}",
+                          i ? "," : "", kProfileStageNames[static_cast<int>(e.stage)],
+                          static_cast<long long>(e.startUs), static_cast<long long>(e.durationUs), e.pixels);
+            json += event;
+        }
+        json += "],\"otherData\":{\"droppedEvents\":" + std::to_string(droppedEvents) + "}}";
+        return json;
+    }
+
+private:
+    struct TraceEvent {
+        ProfileStage stage;
+        int64_t startUs;
+        int64_t durationUs;
+        double pixels;
+    };
+
+    int64_t microseconds(Clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - origin).count();
+    }
+
+    StageTotals totals[kProfileStageCount];
+    double parallelWallMs = 0;
+    double parallelBusyMs = 0;
+    double parallelCapacityMs = 0;
+    uint32_t cacheHits = 0;
+    uint32_t cacheMisses = 0;
+
+    bool tracing = false;
+    std::vector<TraceEvent> events;
+    uint64_t droppedEvents = 0;
+    Clock::time_point origin = Clock::now();
+};
+
+// Times the enclosing block as one stage
+class ScopedStage {
+public:
+    ScopedStage(Profiler& profiler, ProfileStage stage, double pixels = 0)
+        : profiler(profiler), stage(stage), pixels(pixels), start(Profiler::Clock::now()) {}
+
+    ~ScopedStage() {
+        profiler.record(stage, start, Profiler::Clock::now(), pixels);
+    }
+
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+private:
+    Profiler& profiler;
+    ProfileStage stage;
+    double pixels;
+    Profiler::Clock::time_point start;
+};
@@ -0,0 +1,316 @@
+// Interleaved rANS entropy coder
+//
+// Byte symbols are coded with semi-static frequency tables (12-bit
+// probabilities) chosen per symbol from a small set of contexts. Symbol i is
+// coded by state i % kLanes, and its context is taken from symbol i - kLanes
+// of the same lane. Every symbol in a group of kLanes therefore decodes
+// independently of its neighbours, so the decoder can run one lane per
+// vector element; only the 16-bit refills stay serial.
+//
+// The model adapts through its contexts, not over time: tables are counted
+// over the whole input and sent up front. Frequencies that adapt per symbol
+// would make every decode step wait for the previous symbol's update, which
+// serialises the lanes, and they would rule out the reciprocal tables the
+// encoder precomputes per symbol. One pass per frame is cheap next to that.
+//
+// No symbol gets all of kProbScale, so each one costs some fraction of a
+// bit and the decoder can bound the symbol count by the input size before
+// allocating.
+//
+// Stream layout:
+//   varint  symbol count (up to 64 bits)
+//   tables  kContexts frequency tables (zero-run coded varints)
+//   u32 x kLanes  final encoder states, little endian
+//   u16 ...       renormalisation words in decode order
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace rans {
+
+constexpr int kLanes = 8;
+constexpr int kContexts = 4;
+constexpr int kProbBits = 12;
+constexpr uint32_t kProbScale = 1u << kProbBits;
+constexpr uint32_t kStateLow = 1u << 15;  // States live in [kStateLow, 2^31)
+
+// Context of a symbol from the previous symbol in its lane. Tuned for
+// zigzag-mapped prediction residuals, where small values dominate.
+inline int contextOf(uint8_t previous) {
+    if (previous == 0) return 0;
+    if (previous <= 2) return 1;
+    if (previous <= 10) return 2;
+    return 3;
+}
+
+struct SymbolStats {
+    std::array<uint16_t, 256> freq{};
+    std::array<uint16_t, 256> start{};
+};
+
+// Division-free encoder step: x / freq becomes a multiply by a rounded
+// reciprocal, exact for the 31-bit states used here
+struct EncodeSymbol {
+    uint32_t xMax = 0;
+    uint32_t rcpFreq = 0;
+    uint32_t rcpShift = 0;
+    uint32_t bias = 0;
+    uint32_t cmplFreq = 0;
+
+    void init(uint32_t start, uint32_t freq) {
+        xMax = freq << (31 - kProbBits);
+        cmplFreq = kProbScale - freq;
+        if (freq < 2) {
+            rcpFreq = ~0u;
+            rcpShift = 0;
+            bias = start + kProbScale - 1;
+        } else {
+            uint32_t shift = 0;
+            while (freq > (1u << shift)) shift++;
+            rcpFreq = static_cast<uint32_t>(((1ull << (shift + 31)) + freq - 1) / freq);
+            rcpShift = shift - 1;
+            bias = start;
+        }
+    }
+};
+
+struct DecodeEntry {
+    uint16_t freq;
+    uint16_t start;
+    uint8_t symbol;
+};
+
+// Scale raw counts to sum to kProbScale, keeping every used symbol >= 1
+inline void normalize(const std::array<uint64_t, 256>& counts, SymbolStats& stats) {
+    uint64_t total = 0;
+    for (uint64_t c : counts) total += c;
+    stats.freq.fill(0);
+    if (total == 0) return;
+
+    int sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        if (counts[s] == 0) continue;
+        stats.freq[s] = static_cast<uint16_t>(std::max<uint64_t>(1, counts[s] * kProbScale / total));
+        sum += stats.freq[s];
+        if (counts[s] > counts[largest]) largest = s;
+    }
+
+    // A lone symbol would cost nothing to code; give a neighbour one slot
+    if (stats.freq[largest] >= kProbScale) {
+        stats.freq[(largest + 1) & 255] = 1;
+        sum++;
+    }
+
+    // Rounding error goes to the most frequent symbol where it costs least;
+    // if that is not enough, shave the other symbols that can spare it
+    int excess = sum - static_cast<int>(kProbScale);
+    int take = std::min(excess, static_cast<int>(stats.freq[largest]) - 1);
+    stats.freq[largest] -= take;
+    excess -= take;
+    for (int s = 0; excess > 0 && s < 256; s++) {
+        if (stats.freq[s] > 1) {
+            take = std::min(excess, stats.freq[s] - 1);
+            stats.freq[s] -= take;
+            excess -= take;
+        }
+    }
+}
+
+inline void computeStarts(SymbolStats& stats) {
+    uint32_t start = 0;
+    for (int s = 0; s < 256; s++) {
+        stats.start[s] = static_cast<uint16_t>(start);
+        start += stats.freq[s];
+    }
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return false;
+        const uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Frequencies as varints; a zero is followed by the count of further zeros
+inline void writeTable(std::vector<uint8_t>& out, const SymbolStats& stats) {
+    for (int s = 0; s < 256; s++) {
+        putVarint(out, stats.freq[s]);
+        if (stats.freq[s] == 0) {
+            int run = 0;
+            while (s + 1 < 256 && stats.freq[s + 1] == 0) {
+                run++;
+                s++;
+            }
+            putVarint(out, run);
+        }
+    }
+}
+
+inline bool readTable(const uint8_t*& p, const uint8_t* end, SymbolStats& stats) {
+    stats.freq.fill(0);
+    uint32_t total = 0;
+    for (int s = 0; s < 256; s++) {
+        uint64_t freq;
+        if (!getVarint(p, end, freq) || freq >= kProbScale) return false;
+        stats.freq[s] = static_cast<uint16_t>(freq);
+        total += static_cast<uint32_t>(freq);
+        if (freq == 0) {
+            uint64_t run;
+            if (!getVarint(p, end, run) || run >= static_cast<uint64_t>(256 - s)) return false;
+            s += static_cast<int>(run);
+        }
+    }
+    if (total != 0 && total != kProbScale) return false;
+    computeStarts(stats);
+    return true;
+}
+
+// Append the coded form of data[0, size) to `out`
+inline void encode(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    putVarint(out, size);
+
+    // Model: per-context histograms, normalized and sent up front. Counts
+    // are 64-bit, as memory64 builds can code frames over 4 GiB in one call.
+    std::array<std::array<uint64_t, 256>, kContexts> counts{};
+    for (size_t i = 0; i < size; i++) {
+        const int ctx = i >= kLanes ? contextOf(data[i - kLanes]) : 0;
+        counts[ctx][data[i]]++;
+    }
+
+    std::array<SymbolStats, kContexts> stats;
+    std::vector<EncodeSymbol> symbols(kContexts * 256);
+    for (int c = 0; c < kContexts; c++) {
+        normalize(counts[c], stats[c]);
+        computeStarts(stats[c]);
+        writeTable(out, stats[c]);
+        for (int s = 0; s < 256; s++) {
+            if (stats[c].freq[s]) symbols[c * 256 + s].init(stats[c].start[s], stats[c].freq[s]);
+        }
+    }
+
+    // Symbols are pushed in reverse so the decoder can run forwards
+    uint32_t state[kLanes];
+    std::fill(state, state + kLanes, kStateLow);
+    std::vector<uint16_t> words;
+    words.reserve(size / 2 + kLanes);
+
+    for (size_t n = size; n-- > 0;) {
+        const int lane = static_cast<int>(n % kLanes);
+        const int ctx = n >= kLanes ? contextOf(data[n - kLanes]) : 0;
+        const EncodeSymbol& symbol = symbols[ctx * 256 + data[n]];
+        uint32_t x = state[lane];
+
+        // Keep x / freq below 2^19 so the result stays under 2^31
+        if (x >= symbol.xMax) {
+            words.push_back(static_cast<uint16_t>(x));
+            x >>= 16;
+        }
+
+        // x + bias + (x / freq) * (scale - freq) == (x / freq) * scale + x % freq + start
+        const uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(x) * symbol.rcpFreq) >> 32) >> symbol.rcpShift;
+        state[lane] = x + symbol.bias + q * symbol.cmplFreq;
+    }
+
+    for (int lane = 0; lane < kLanes; lane++) {
+        for (int b = 0; b < 4; b++) {
+            out.push_back(static_cast<uint8_t>(state[lane] >> (8 * b)));
+        }
+    }
+    for (size_t i = words.size(); i-- > 0;) {
+        out.push_back(static_cast<uint8_t>(words[i]));
+        out.push_back(static_cast<uint8_t>(words[i] >> 8));
+    }
+}
+
+// Decode a stream written by encode(); false on malformed input
+inline bool decode(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+
+    uint64_t count;
+    if (!getVarint(p, end, count)) return false;
+
+    // Slot -> (symbol, freq, start) lookup per context
+    std::vector<DecodeEntry> tables(static_cast<size_t>(kContexts) * kProbScale);
+    uint32_t maxFreq = 0;
+    for (int c = 0; c < kContexts; c++) {
+        SymbolStats stats;
+        if (!readTable(p, end, stats)) return false;
+        maxFreq = std::max<uint32_t>(maxFreq, *std::max_element(stats.freq.begin(), stats.freq.end()));
+        DecodeEntry* table = &tables[static_cast<size_t>(c) * kProbScale];
+        for (int s = 0; s < 256; s++) {
+            for (uint32_t slot = stats.start[s]; slot < stats.start[s] + stats.freq[s]; slot++) {
+                table[slot] = {stats.freq[s], stats.start[s], static_cast<uint8_t>(s)};
+            }
+        }
+    }
+
+    if (end - p < 4 * kLanes) return false;
+
+    // Each symbol moves at least half of log2(kProbScale / freq) bits from
+    // the states and words into the output, so the bytes left cap the count
+    // before anything is allocated for it
+    if (maxFreq == 0) {
+        if (count != 0) return false;
+    } else {
+        const double minBits = std::log2(static_cast<double>(kProbScale) / maxFreq) / 2;
+        if (count > 8.0 * static_cast<double>(end - p) / minBits + kLanes) return false;
+    }
+
+    uint32_t state[kLanes];
+    for (int lane = 0; lane < kLanes; lane++) {
+        state[lane] = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        p += 4;
+    }
+
+    // A 32-bit build cannot hold more symbols than its address space
+    if (count > std::numeric_limits<size_t>::max()) return false;
+    const size_t symbols = static_cast<size_t>(count);
+
+    out.resize(symbols);
+    for (size_t i = 0; i < symbols; i += kLanes) {
+        const int lanes = static_cast<int>(std::min<size_t>(kLanes, symbols - i));
+
+        // Independent per lane: contexts come from the previous group
+        for (int lane = 0; lane < lanes; lane++) {
+            const int ctx = i >= kLanes ? contextOf(out[i + lane - kLanes]) : 0;
+            const uint32_t x = state[lane];
+            const uint32_t slot = x & (kProbScale - 1);
+            const DecodeEntry& entry = tables[static_cast<size_t>(ctx) * kProbScale + slot];
+            if (entry.freq == 0) return false;
+            out[i + lane] = entry.symbol;
+            state[lane] = entry.freq * (x >> kProbBits) + slot - entry.start;
+        }
+
+        // Refills consume the shared word stream in lane order
+        for (int lane = 0; lane < lanes; lane++) {
+            if (state[lane] < kStateLow) {
+                if (end - p < 2) return false;
+                state[lane] = (state[lane] << 16) | p[0] | (p[1] << 8);
+                p += 2;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace rans
@@ -0,0 +1,162 @@
+// Bump allocator for per-call working buffers
+//
+// Transient buffers are carved out of large blocks by advancing an offset,
+// and everything allocated inside a ScratchScope is given back when the
+// scope closes. Once an arena has grown to an operation's working set, that
+// operation makes no heap calls at all. If an operation overflowed into
+// extra blocks, the blocks are merged into one of the combined size when the
+// arena next empties. A long session therefore settles on one allocation
+// per arena instead of fragmenting the heap.
+//
+// Arenas are single-threaded; parallel kernels use one per participant.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct ScratchStats {
+    double highWaterBytes = 0;  // double so embind hands JS a plain number
+    double capacityBytes = 0;
+    double heapBytes = 0;       // Bytes taken from the heap since creation
+    uint32_t arenas = 0;
+};
+
+class ScratchArena {
+public:
+    static constexpr size_t kAlignment = 16;         // v128 / SSE width
+    static constexpr size_t kMinBlockSize = 64 * 1024;
+
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+        size_t used = 0;
+    };
+
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Uninitialized, kAlignment-aligned storage for count Ts
+    template<typename T>
+    T* alloc(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+        static_assert(alignof(T) <= kAlignment, "over-aligned type");
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    void* allocate(size_t bytes) {
+        bytes = std::max<size_t>(bytes, 1);
+        if (blocks.empty() || !fits(blocks[current], offset, bytes)) {
+            nextBlock(bytes);
+        }
+
+        Block& block = blocks[current];
+        const size_t start = alignedOffset(block, offset);
+        used += start - offset + bytes;
+        offset = start + bytes;
+        highWater = std::max(highWater, used);
+        return block.data.get() + start;
+    }
+
+    Marker mark() const {
+        return {current, offset, used};
+    }
+
+    // Free everything allocated since `marker`
+    void release(const Marker& marker) {
+        current = marker.block;
+        offset = marker.offset;
+        used = marker.used;
+        if (used == 0 && blocks.size() > 1) {
+            coalesce();
+        }
+    }
+
+    // Most bytes in use at once since creation
+    size_t getHighWater() const {
+        return highWater;
+    }
+
+    size_t getCapacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+
+    // Bytes taken from the heap since creation, coalescing included
+    size_t getHeapBytes() const {
+        return heapBytes;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+    };
+
+    static size_t alignedOffset(const Block& block, size_t offset) {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        const uintptr_t aligned = (base + offset + kAlignment - 1) & ~static_cast<uintptr_t>(kAlignment - 1);
+        return aligned - base;
+    }
+
+    static bool fits(const Block& block, size_t offset, size_t bytes) {
+        const size_t start = alignedOffset(block, offset);
+        return start <= block.size && block.size - start >= bytes;
+    }
+
+    // Continue in a later block that is already big enough, or append one
+    // that at least doubles the arena. Blocks past `current` are unused.
+    void nextBlock(size_t bytes) {
+        const size_t next = blocks.empty() ? 0 : current + 1;
+        if (next < blocks.size() && fits(blocks[next], 0, bytes)) {
+            current = next;
+            offset = 0;
+            return;
+        }
+
+        blocks.resize(next);
+        const size_t size = std::max({kMinBlockSize, bytes + kAlignment, getCapacity()});
+        blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+        heapBytes += size;
+        current = next;
+        offset = 0;
+    }
+
+    void coalesce() {
+        const size_t size = getCapacity();
+        blocks.clear();
+        blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+        heapBytes += size;
+        current = 0;
+        offset = 0;
+    }
+
+    std::vector<Block> blocks;
+    size_t current = 0;  // Block being bumped
+    size_t offset = 0;   // Next free byte in blocks[current]
+    size_t used = 0;     // Bytes handed out, alignment padding included
+    size_t highWater = 0;
+    size_t heapBytes = 0;
+};
+
+// Releases everything the enclosed code allocated from `arena`
+class ScratchScope {
+public:
+    explicit ScratchScope(ScratchArena& arena) : arena(arena), marker(arena.mark()) {}
+
+    ~ScratchScope() {
+        arena.release(marker);
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+    ScratchArena& arena;
+    ScratchArena::Marker marker;
+};
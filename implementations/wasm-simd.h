@@ -0,0 +1,570 @@
+// Portable SIMD layer for the image processing kernels
+//
+// Compiles to WASM SIMD128 (-msimd128), to SSE4.1/AVX2 for native builds,
+// and to plain arrays everywhere else. The array fallback keeps the vector
+// code paths buildable; ImageProcessor still selects its scalar reference
+// kernels when kAvailable is false or SIMD is switched off at runtime.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define IMAGE_SIMD_WASM128 1
+#elif defined(__SSE4_1__)
+#include <immintrin.h>
+#define IMAGE_SIMD_SSE4 1
+#if defined(__AVX2__) && defined(__FMA__)
+#define IMAGE_SIMD_AVX2 1
+#endif
+#endif
+
+namespace simd {
+
+#if defined(IMAGE_SIMD_WASM128) || defined(IMAGE_SIMD_SSE4)
+constexpr bool kAvailable = true;
+#else
+constexpr bool kAvailable = false;
+#endif
+
+// ---------------------------------------------------------------------------
+// Four float lanes, available on every target
+// ---------------------------------------------------------------------------
+struct F32x4 {
+#if defined(IMAGE_SIMD_WASM128)
+    v128_t v;
+#elif defined(IMAGE_SIMD_SSE4)
+    __m128 v;
+#else
+    float v[4];
+#endif
+};
+
+inline F32x4 zero4() {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_f32x4_splat(0.0f)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_setzero_ps()};
+#else
+    return {{0.0f, 0.0f, 0.0f, 0.0f}};
+#endif
+}
+
+inline F32x4 splat4(float x) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_f32x4_splat(x)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_set1_ps(x)};
+#else
+    return {{x, x, x, x}};
+#endif
+}
+
+inline F32x4 load4(const float* p) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_v128_load(p)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_loadu_ps(p)};
+#else
+    return {{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+inline void store4(float* p, F32x4 a) {
+#if defined(IMAGE_SIMD_WASM128)
+    wasm_v128_store(p, a.v);
+#elif defined(IMAGE_SIMD_SSE4)
+    _mm_storeu_ps(p, a.v);
+#else
+    std::memcpy(p, a.v, sizeof(a.v));
+#endif
+}
+
+inline F32x4 add(F32x4 a, F32x4 b) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_f32x4_add(a.v, b.v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_add_ps(a.v, b.v)};
+#else
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+inline F32x4 sub(F32x4 a, F32x4 b) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_f32x4_sub(a.v, b.v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_sub_ps(a.v, b.v)};
+#else
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+#endif
+}
+
+inline F32x4 mul(F32x4 a, F32x4 b) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_f32x4_mul(a.v, b.v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_mul_ps(a.v, b.v)};
+#else
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+#endif
+}
+
+// Operators let templated kernels run on either float or F32x4
+inline F32x4 operator+(F32x4 a, F32x4 b) { return add(a, b); }
+inline F32x4 operator-(F32x4 a, F32x4 b) { return sub(a, b); }
+inline F32x4 operator*(F32x4 a, float b) { return mul(a, splat4(b)); }
+
+// acc + a * b
+inline F32x4 madd(F32x4 acc, F32x4 a, F32x4 b) {
+#if defined(IMAGE_SIMD_AVX2)
+    return {_mm_fmadd_ps(a.v, b.v, acc.v)};
+#else
+    return add(acc, mul(a, b));
+#endif
+}
+
+inline float hsum(F32x4 a) {
+#if defined(IMAGE_SIMD_WASM128)
+    return wasm_f32x4_extract_lane(a.v, 0) + wasm_f32x4_extract_lane(a.v, 1) +
+           wasm_f32x4_extract_lane(a.v, 2) + wasm_f32x4_extract_lane(a.v, 3);
+#elif defined(IMAGE_SIMD_SSE4)
+    __m128 shuf = _mm_movehdup_ps(a.v);
+    __m128 sums = _mm_add_ps(a.v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+#else
+    return a.v[0] + a.v[1] + a.v[2] + a.v[3];
+#endif
+}
+
+// Widen four consecutive bytes to floats
+inline F32x4 loadU8x4(const uint8_t* p) {
+#if defined(IMAGE_SIMD_WASM128)
+    uint32_t bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    v128_t v = wasm_u32x4_extend_low_u16x8(wasm_u16x8_extend_low_u8x16(wasm_i32x4_splat(bytes)));
+    return {wasm_f32x4_convert_i32x4(v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    int bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    return {_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)))};
+#else
+    return {{float(p[0]), float(p[1]), float(p[2]), float(p[3])}};
+#endif
+}
+
+// Round half up, saturate to [0, 255] and store four bytes
+inline void storeU8x4(uint8_t* p, F32x4 a) {
+#if defined(IMAGE_SIMD_WASM128)
+    v128_t i = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(a.v, wasm_f32x4_splat(0.5f)));
+    v128_t w = wasm_i16x8_narrow_i32x4(i, i);
+    v128_t b = wasm_u8x16_narrow_i16x8(w, w);
+    uint32_t bytes = wasm_i32x4_extract_lane(b, 0);
+    std::memcpy(p, &bytes, sizeof(bytes));
+#elif defined(IMAGE_SIMD_SSE4)
+    __m128i i = _mm_cvttps_epi32(_mm_add_ps(a.v, _mm_set1_ps(0.5f)));
+    __m128i w = _mm_packs_epi32(i, i);
+    int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+    std::memcpy(p, &bytes, sizeof(bytes));
+#else
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<uint8_t>(std::clamp(static_cast<int>(a.v[i] + 0.5f), 0, 255));
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Widest float vector for streaming row kernels: 8 lanes on AVX2, else 4
+// ---------------------------------------------------------------------------
+#if defined(IMAGE_SIMD_AVX2)
+struct VecF {
+    __m256 v;
+};
+constexpr int kLanes = 8;
+
+inline VecF zero() { return {_mm256_setzero_ps()}; }
+inline VecF splat(float x) { return {_mm256_set1_ps(x)}; }
+inline VecF load(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float* p, VecF a) { _mm256_storeu_ps(p, a.v); }
+inline VecF add(VecF a, VecF b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline VecF mul(VecF a, VecF b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline VecF madd(VecF acc, VecF a, VecF b) { return {_mm256_fmadd_ps(a.v, b.v, acc.v)}; }
+
+inline VecF loadU8(const uint8_t* p) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes))};
+}
+
+inline float hsum(VecF a) {
+    return hsum(F32x4{_mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1))});
+}
+#else
+using VecF = F32x4;
+constexpr int kLanes = 4;
+
+inline VecF zero() { return zero4(); }
+inline VecF splat(float x) { return splat4(x); }
+inline VecF load(const float* p) { return load4(p); }
+inline void store(float* p, VecF a) { store4(p, a); }
+inline VecF loadU8(const uint8_t* p) { return loadU8x4(p); }
+#endif
+
+// ---------------------------------------------------------------------------
+// Reductions over byte rows
+// ---------------------------------------------------------------------------
+
+// Sum and sum of squares of n samples spaced `stride` bytes apart.
+// Strides 1 and 4 (grey and RGBA channel 0) take the vector path.
+inline void sumU8(const uint8_t* p, int n, int stride, float& sum, float& sumSq) {
+    F32x4 s = zero4();
+    F32x4 s2 = zero4();
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 4 <= n; i += 4) {
+            F32x4 x = loadU8x4(p + i);
+            s = add(s, x);
+            s2 = madd(s2, x, x);
+        }
+    } else if (stride == 4) {
+        for (; i + 4 <= n; i += 4) {
+            const uint8_t* q = p + i * 4;
+#if defined(IMAGE_SIMD_WASM128)
+            v128_t px = wasm_v128_load(q);
+            F32x4 x = {wasm_f32x4_convert_i32x4(wasm_v128_and(px, wasm_i32x4_splat(0xFF)))};
+#elif defined(IMAGE_SIMD_SSE4)
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+            F32x4 x = {_mm_cvtepi32_ps(_mm_and_si128(px, _mm_set1_epi32(0xFF)))};
+#else
+            F32x4 x = {{float(q[0]), float(q[4]), float(q[8]), float(q[12])}};
+#endif
+            s = add(s, x);
+            s2 = madd(s2, x, x);
+        }
+    }
+
+    float total = hsum(s);
+    float totalSq = hsum(s2);
+    for (; i < n; i++) {
+        float x = p[static_cast<size_t>(i) * stride];
+        total += x;
+        totalSq += x * x;
+    }
+    sum += total;
+    sumSq += totalSq;
+}
+
+// ---------------------------------------------------------------------------
+// Colour conversion
+// ---------------------------------------------------------------------------
+
+// BT.601 studio-range RGB -> YCbCr in Q14, the matrix VP8 expects. Chroma
+// rows take sums of four pixels, hence the extra two bits of shift.
+constexpr int kYuvBits = 14;
+constexpr int kLumaR = 4207, kLumaG = 8260, kLumaB = 1604;
+constexpr int kLumaBias = (16 << kYuvBits) + (1 << (kYuvBits - 1));
+constexpr int kCbR = -2428, kCbG = -4768, kCbB = 7196;
+constexpr int kCrR = 7196, kCrG = -6026, kCrB = -1170;
+constexpr int kChromaBias = (128 << (kYuvBits + 2)) + (1 << (kYuvBits + 1));
+
+inline uint8_t luma(int r, int g, int b) {
+    return static_cast<uint8_t>((kLumaR * r + kLumaG * g + kLumaB * b + kLumaBias) >> kYuvBits);
+}
+
+// Cb / Cr of a 2x2 block from its channel sums
+inline uint8_t chromaBlue(int r4, int g4, int b4) {
+    return static_cast<uint8_t>((kCbR * r4 + kCbG * g4 + kCbB * b4 + kChromaBias) >> (kYuvBits + 2));
+}
+
+inline uint8_t chromaRed(int r4, int g4, int b4) {
+    return static_cast<uint8_t>((kCrR * r4 + kCrG * g4 + kCrB * b4 + kChromaBias) >> (kYuvBits + 2));
+}
+
+// Four RGB or RGBA pixels as 16 bytes in R G B x order. The x byte is
+// whatever follows B; the colour kernels give it a zero weight. RGB reads
+// 16 bytes from p, four more than the pixels span.
+#if defined(IMAGE_SIMD_WASM128)
+inline v128_t loadRGBx(const uint8_t* p, int stride) {
+    const v128_t px = wasm_v128_load(p);
+    if (stride == 4) return px;
+    return wasm_i8x16_swizzle(px, wasm_i8x16_make(0, 1, 2, 16, 3, 4, 5, 16, 6, 7, 8, 16, 9, 10, 11, 16));
+}
+#elif defined(IMAGE_SIMD_SSE4)
+inline __m128i loadRGBx(const uint8_t* p, int stride) {
+    const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    if (stride == 4) return px;
+    return _mm_shuffle_epi8(px, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+}
+#endif
+
+// In a row of n pixels of `stride` (3 or 4) bytes, the vector loops may
+// load 16 bytes at any pixel before this one
+inline int rgbxLoadEnd(int n, int stride) {
+    return stride == 4 ? n - 3 : n - 5;
+}
+
+// Luma of n pixels spaced `stride` bytes apart, R G B first. RGB and RGBA
+// take the vector path, four pixels per step; the result is the same as
+// the scalar formula.
+inline void lumaRow(const uint8_t* p, int n, int stride, uint8_t* y) {
+    int i = 0;
+#if defined(IMAGE_SIMD_WASM128)
+    if (stride == 3 || stride == 4) {
+        const v128_t k = wasm_i16x8_make(kLumaR, kLumaG, kLumaB, 0, kLumaR, kLumaG, kLumaB, 0);
+        const v128_t bias = wasm_i32x4_splat(kLumaBias);
+        for (const int end = rgbxLoadEnd(n, stride); i < end; i += 4) {
+            v128_t px = loadRGBx(p + i * stride, stride);
+            v128_t a = wasm_i32x4_dot_i16x8(wasm_u16x8_extend_low_u8x16(px), k);
+            v128_t b = wasm_i32x4_dot_i16x8(wasm_u16x8_extend_high_u8x16(px), k);
+            v128_t sum = wasm_i32x4_add(wasm_i32x4_shuffle(a, b, 0, 2, 4, 6), wasm_i32x4_shuffle(a, b, 1, 3, 5, 7));
+            v128_t v = wasm_i32x4_shr(wasm_i32x4_add(sum, bias), kYuvBits);
+            v128_t w = wasm_i16x8_narrow_i32x4(v, v);
+            uint32_t bytes = wasm_i32x4_extract_lane(wasm_u8x16_narrow_i16x8(w, w), 0);
+            std::memcpy(y + i, &bytes, sizeof(bytes));
+        }
+    }
+#elif defined(IMAGE_SIMD_SSE4)
+    if (stride == 3 || stride == 4) {
+        const __m128i k = _mm_setr_epi16(kLumaR, kLumaG, kLumaB, 0, kLumaR, kLumaG, kLumaB, 0);
+        const __m128i bias = _mm_set1_epi32(kLumaBias);
+        for (const int end = rgbxLoadEnd(n, stride); i < end; i += 4) {
+            __m128i px = loadRGBx(p + i * stride, stride);
+            __m128i a = _mm_madd_epi16(_mm_cvtepu8_epi16(px), k);
+            __m128i b = _mm_madd_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(px, 8)), k);
+            __m128i v = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(a, b), bias), kYuvBits);
+            __m128i w = _mm_packs_epi32(v, v);
+            int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+            std::memcpy(y + i, &bytes, sizeof(bytes));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        const uint8_t* q = p + static_cast<size_t>(i) * stride;
+        y[i] = luma(q[0], q[1], q[2]);
+    }
+}
+
+// Cb and Cr of one 4:2:0 chroma row from two rows of n pixels, `stride`
+// bytes apart with R G B first. An odd last column pairs with itself. RGB
+// and RGBA take the vector path, four chroma samples (eight pixels) per
+// step; the result is the same as the scalar formula.
+inline void chromaRow(const uint8_t* row0, const uint8_t* row1, int n, int stride, uint8_t* u, uint8_t* v) {
+    const int chromaWidth = (n + 1) / 2;
+    int cx = 0;
+#if defined(IMAGE_SIMD_WASM128)
+    if (stride == 3 || stride == 4) {
+        const v128_t kb = wasm_i16x8_make(kCbR, kCbG, kCbB, 0, kCbR, kCbG, kCbB, 0);
+        const v128_t kr = wasm_i16x8_make(kCrR, kCrG, kCrB, 0, kCrR, kCrG, kCrB, 0);
+        const v128_t bias = wasm_i32x4_splat(kChromaBias);
+        // 2x2 sums of four pixels' R G B x, as two samples of four 16-bit lanes
+        auto sums = [&](size_t offset) {
+            const v128_t a = loadRGBx(row0 + offset, stride);
+            const v128_t b = loadRGBx(row1 + offset, stride);
+            const v128_t lo = wasm_i16x8_add(wasm_u16x8_extend_low_u8x16(a), wasm_u16x8_extend_low_u8x16(b));
+            const v128_t hi = wasm_i16x8_add(wasm_u16x8_extend_high_u8x16(a), wasm_u16x8_extend_high_u8x16(b));
+            return wasm_i16x8_add(wasm_i64x2_shuffle(lo, hi, 0, 2), wasm_i64x2_shuffle(lo, hi, 1, 3));
+        };
+        auto toBytes = [&](v128_t a, v128_t b) {
+            v128_t sum = wasm_i32x4_add(wasm_i32x4_shuffle(a, b, 0, 2, 4, 6), wasm_i32x4_shuffle(a, b, 1, 3, 5, 7));
+            v128_t w = wasm_i32x4_shr(wasm_i32x4_add(sum, bias), kYuvBits + 2);
+            w = wasm_i16x8_narrow_i32x4(w, w);
+            return static_cast<uint32_t>(wasm_i32x4_extract_lane(wasm_u8x16_narrow_i16x8(w, w), 0));
+        };
+        for (const int end = rgbxLoadEnd(n, stride) - 4; cx * 2 < end; cx += 4) {
+            const size_t x = static_cast<size_t>(cx) * 2 * stride;
+            const v128_t s01 = sums(x);
+            const v128_t s23 = sums(x + 4 * stride);
+            const uint32_t cb = toBytes(wasm_i32x4_dot_i16x8(s01, kb), wasm_i32x4_dot_i16x8(s23, kb));
+            const uint32_t cr = toBytes(wasm_i32x4_dot_i16x8(s01, kr), wasm_i32x4_dot_i16x8(s23, kr));
+            std::memcpy(u + cx, &cb, sizeof(cb));
+            std::memcpy(v + cx, &cr, sizeof(cr));
+        }
+    }
+#elif defined(IMAGE_SIMD_SSE4)
+    if (stride == 3 || stride == 4) {
+        const __m128i kb = _mm_setr_epi16(kCbR, kCbG, kCbB, 0, kCbR, kCbG, kCbB, 0);
+        const __m128i kr = _mm_setr_epi16(kCrR, kCrG, kCrB, 0, kCrR, kCrG, kCrB, 0);
+        const __m128i bias = _mm_set1_epi32(kChromaBias);
+        // 2x2 sums of four pixels' R G B x, as two samples of four 16-bit lanes
+        auto sums = [&](size_t offset) {
+            const __m128i a = loadRGBx(row0 + offset, stride);
+            const __m128i b = loadRGBx(row1 + offset, stride);
+            const __m128i lo = _mm_add_epi16(_mm_cvtepu8_epi16(a), _mm_cvtepu8_epi16(b));
+            const __m128i hi = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)),
+                                             _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)));
+            return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+        };
+        auto toBytes = [&](__m128i a, __m128i b) {
+            __m128i w = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(a, b), bias), kYuvBits + 2);
+            w = _mm_packs_epi32(w, w);
+            return _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+        };
+        for (const int end = rgbxLoadEnd(n, stride) - 4; cx * 2 < end; cx += 4) {
+            const size_t x = static_cast<size_t>(cx) * 2 * stride;
+            const __m128i s01 = sums(x);
+            const __m128i s23 = sums(x + 4 * stride);
+            const int cb = toBytes(_mm_madd_epi16(s01, kb), _mm_madd_epi16(s23, kb));
+            const int cr = toBytes(_mm_madd_epi16(s01, kr), _mm_madd_epi16(s23, kr));
+            std::memcpy(u + cx, &cb, sizeof(cb));
+            std::memcpy(v + cx, &cr, sizeof(cr));
+        }
+    }
+#endif
+    for (; cx < chromaWidth; cx++) {
+        const size_t x0 = static_cast<size_t>(cx) * 2 * stride;
+        const size_t x1 = static_cast<size_t>(std::min(cx * 2 + 1, n - 1)) * stride;
+        const int r = row0[x0] + row0[x1] + row1[x0] + row1[x1];
+        const int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+        const int b = row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2];
+        u[cx] = chromaBlue(r, g, b);
+        v[cx] = chromaRed(r, g, b);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Four 32-bit integer lanes, for hashing
+// ---------------------------------------------------------------------------
+struct U32x4 {
+#if defined(IMAGE_SIMD_WASM128)
+    v128_t v;
+#elif defined(IMAGE_SIMD_SSE4)
+    __m128i v;
+#else
+    uint32_t v[4];
+#endif
+};
+
+inline U32x4 splatU32(uint32_t x) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_i32x4_splat(static_cast<int32_t>(x))};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_set1_epi32(static_cast<int>(x))};
+#else
+    return {{x, x, x, x}};
+#endif
+}
+
+inline U32x4 setU32(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_u32x4_make(a, b, c, d)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_setr_epi32(static_cast<int>(a), static_cast<int>(b), static_cast<int>(c), static_cast<int>(d))};
+#else
+    return {{a, b, c, d}};
+#endif
+}
+
+// Sixteen bytes as four little-endian words
+inline U32x4 loadU32x4(const uint8_t* p) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_v128_load(p)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))};
+#else
+    U32x4 r;
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = p[4 * i] | (p[4 * i + 1] << 8) | (p[4 * i + 2] << 16) | (static_cast<uint32_t>(p[4 * i + 3]) << 24);
+    }
+    return r;
+#endif
+}
+
+inline void storeU32x4(uint32_t* p, U32x4 a) {
+#if defined(IMAGE_SIMD_WASM128)
+    wasm_v128_store(p, a.v);
+#elif defined(IMAGE_SIMD_SSE4)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.v);
+#else
+    std::memcpy(p, a.v, sizeof(a.v));
+#endif
+}
+
+inline U32x4 addU32(U32x4 a, U32x4 b) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_i32x4_add(a.v, b.v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_add_epi32(a.v, b.v)};
+#else
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+inline U32x4 mulU32(U32x4 a, U32x4 b) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_i32x4_mul(a.v, b.v)};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_mullo_epi32(a.v, b.v)};
+#else
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+#endif
+}
+
+template <int R>
+inline U32x4 rotlU32(U32x4 a) {
+#if defined(IMAGE_SIMD_WASM128)
+    return {wasm_v128_or(wasm_i32x4_shl(a.v, R), wasm_u32x4_shr(a.v, 32 - R))};
+#elif defined(IMAGE_SIMD_SSE4)
+    return {_mm_or_si128(_mm_slli_epi32(a.v, R), _mm_srli_epi32(a.v, 32 - R))};
+#else
+    U32x4 r;
+    for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] << R) | (a.v[i] >> (32 - R));
+    return r;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Content hashing
+// ---------------------------------------------------------------------------
+
+// 64-bit hash of n bytes. xxHash32-style rounds on two four-lane
+// accumulators (32 bytes per step), folded with xxHash64 mixing. Pure
+// integer arithmetic, so every backend yields the same value and hashes
+// can be persisted across builds.
+inline uint64_t hash64(const uint8_t* p, size_t n, uint64_t seed = 0) {
+    constexpr uint32_t kPrime1 = 2654435761u;
+    constexpr uint32_t kPrime2 = 2246822519u;
+    constexpr uint64_t kPrime64a = 11400714785074694791ull;
+    constexpr uint64_t kPrime64b = 14029467366897019727ull;
+    constexpr uint64_t kPrime64c = 1609587929392839161ull;
+    constexpr uint64_t kPrime64d = 9650029242287828579ull;
+
+    const uint32_t s = static_cast<uint32_t>(seed ^ (seed >> 32));
+    U32x4 a = setU32(s + kPrime1 + kPrime2, s + kPrime2, s, s - kPrime1);
+    U32x4 b = setU32(s ^ kPrime1, s ^ kPrime2, ~s, s + 1);
+    const U32x4 p1 = splatU32(kPrime1);
+    const U32x4 p2 = splatU32(kPrime2);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a = mulU32(rotlU32<13>(addU32(a, mulU32(loadU32x4(p + i), p2))), p1);
+        b = mulU32(rotlU32<13>(addU32(b, mulU32(loadU32x4(p + i + 16), p2))), p1);
+    }
+
+    uint32_t lanes[8];
+    storeU32x4(lanes, a);
+    storeU32x4(lanes + 4, b);
+
+    auto rotl64 = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    uint64_t h = seed + kPrime64d + n;
+    for (uint32_t lane : lanes) {
+        h ^= rotl64(lane * kPrime64b, 31) * kPrime64a;
+        h = rotl64(h, 27) * kPrime64a + kPrime64c;
+    }
+    for (; i < n; i++) {
+        h ^= p[i] * kPrime64d;
+        h = rotl64(h, 11) * kPrime64a;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime64b;
+    h ^= h >> 29;
+    h *= kPrime64c;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace simd
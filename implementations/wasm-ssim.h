@@ -0,0 +1,173 @@
+// Multi-scale SSIM (Wang, Simoncelli & Bovik 2003) on 8-bit luma planes
+//
+// Each scale is scored over 8x8 windows placed every 4 pixels, built from
+// the sums of 4x4 blocks as in x264's SSIM, rather than over an 11x11
+// Gaussian: every pixel is read once per scale and the inner loop is a
+// vertical accumulation that vectorizes. Scales after the first are 2x2
+// box averages of the previous one. The score is the product of the
+// per-scale contrast-structure terms and the coarsest luminance term,
+// raised to the standard scale weights; images too small for five scales
+// use the weights of the scales they have, renormalised.
+#pragma once
+
+#include "wasm-simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace ssim {
+
+constexpr int kMaxScales = 5;
+constexpr double kScaleWeights[kMaxScales] = {0.0448, 0.2856, 0.3001, 0.2363, 0.1333};
+
+// Stabilising constants for 8-bit samples: (0.01 * 255)^2 and (0.03 * 255)^2
+constexpr double kC1 = 6.5025;
+constexpr double kC2 = 58.5225;
+
+constexpr int kBlock = 4;
+
+// 8-bit luma plane
+struct Plane {
+    const uint8_t* data = nullptr;
+    size_t stride = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// A scale needs at least one 8x8 window
+inline bool scaleFits(int width, int height) {
+    return width >= 2 * kBlock && height >= 2 * kBlock;
+}
+
+inline int scaleCount(int width, int height) {
+    int scales = 0;
+    while (scales < kMaxScales && scaleFits(width, height)) {
+        scales++;
+        width /= 2;
+        height /= 2;
+    }
+    return scales;
+}
+
+// Floats of scratch needed by windowTerms for a plane `width` wide
+inline size_t scratchFloats(int width) {
+    const size_t blocks = static_cast<size_t>(width / kBlock);
+    return blocks * kBlock * 4 + blocks * 4 * 2;
+}
+
+// Sums of a, b, a^2 + b^2 and a * b for each 4x4 block of block row `by`,
+// interleaved per block in `sums`. `columns` holds 4 * width floats.
+inline void blockRowSums(const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride, int blocks, int by,
+                         float* columns, float* sums, bool vectorize) {
+    const int n = blocks * kBlock;
+    float* sa = columns;
+    float* sb = columns + n;
+    float* sss = columns + 2 * n;
+    float* sab = columns + 3 * n;
+    std::fill(columns, columns + 4 * n, 0.0f);
+
+    for (int r = 0; r < kBlock; r++) {
+        const uint8_t* rowA = a + static_cast<size_t>(by * kBlock + r) * aStride;
+        const uint8_t* rowB = b + static_cast<size_t>(by * kBlock + r) * bStride;
+        int x = 0;
+        if (vectorize) {
+            for (; x + 4 <= n; x += 4) {
+                const simd::F32x4 va = simd::loadU8x4(rowA + x);
+                const simd::F32x4 vb = simd::loadU8x4(rowB + x);
+                simd::store4(sa + x, simd::add(simd::load4(sa + x), va));
+                simd::store4(sb + x, simd::add(simd::load4(sb + x), vb));
+                simd::store4(sss + x, simd::madd(simd::madd(simd::load4(sss + x), va, va), vb, vb));
+                simd::store4(sab + x, simd::madd(simd::load4(sab + x), va, vb));
+            }
+        }
+        for (; x < n; x++) {
+            const float va = rowA[x];
+            const float vb = rowB[x];
+            sa[x] += va;
+            sb[x] += vb;
+            sss[x] += va * va + vb * vb;
+            sab[x] += va * vb;
+        }
+    }
+
+    // Integer sums stay exact in float: at most 16 * 2 * 255^2 per block
+    for (int bx = 0; bx < blocks; bx++) {
+        const int x = bx * kBlock;
+        float* s = sums + bx * 4;
+        s[0] = sa[x] + sa[x + 1] + sa[x + 2] + sa[x + 3];
+        s[1] = sb[x] + sb[x + 1] + sb[x + 2] + sb[x + 3];
+        s[2] = sss[x] + sss[x + 1] + sss[x + 2] + sss[x + 3];
+        s[3] = sab[x] + sab[x + 1] + sab[x + 2] + sab[x + 3];
+    }
+}
+
+// Add the luminance and contrast-structure terms of windows in window rows
+// [rowBegin, rowEnd) of a width x height plane pair to lSum and csSum.
+// `scratch` holds scratchFloats(width) floats.
+inline void windowTerms(const uint8_t* a, size_t aStride, const uint8_t* b, size_t bStride, int width,
+                        int rowBegin, int rowEnd, float* scratch, bool vectorize, double& lSum, double& csSum) {
+    const int blocks = width / kBlock;
+    float* columns = scratch;
+    float* above = scratch + static_cast<size_t>(blocks) * kBlock * 4;
+    float* below = above + blocks * 4;
+    constexpr double n = 4.0 * kBlock * kBlock;
+
+    blockRowSums(a, aStride, b, bStride, blocks, rowBegin, columns, above, vectorize);
+    for (int wy = rowBegin; wy < rowEnd; wy++) {
+        blockRowSums(a, aStride, b, bStride, blocks, wy + 1, columns, below, vectorize);
+        for (int bx = 0; bx + 1 < blocks; bx++) {
+            double s[4];
+            for (int k = 0; k < 4; k++) {
+                s[k] = static_cast<double>(above[bx * 4 + k]) + above[bx * 4 + 4 + k] + below[bx * 4 + k] +
+                       below[bx * 4 + 4 + k];
+            }
+            const double meanA = s[0] / n;
+            const double meanB = s[1] / n;
+            const double variances = s[2] / n - meanA * meanA - meanB * meanB;
+            const double covariance = s[3] / n - meanA * meanB;
+            lSum += (2.0 * meanA * meanB + kC1) / (meanA * meanA + meanB * meanB + kC1);
+            csSum += (2.0 * covariance + kC2) / (variances + kC2);
+        }
+        std::swap(above, below);
+    }
+}
+
+inline int windowRows(int height) {
+    return height / kBlock - 1;
+}
+
+inline int windowColumns(int width) {
+    return width / kBlock - 1;
+}
+
+// 2x2 box average of rows [rowBegin, rowEnd) of the half-size plane
+inline void downsample(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int dstWidth,
+                       int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const uint8_t* row0 = src + static_cast<size_t>(2 * y) * srcStride;
+        const uint8_t* row1 = row0 + srcStride;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstStride;
+        for (int x = 0; x < dstWidth; x++) {
+            out[x] = static_cast<uint8_t>((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+// Combine per-scale mean terms into the MS-SSIM score
+inline double combine(const double* l, const double* cs, int scales) {
+    if (scales == 0) return 1.0;
+    double weightTotal = 0.0;
+    for (int s = 0; s < scales; s++) weightTotal += kScaleWeights[s];
+
+    double score = 1.0;
+    for (int s = 0; s < scales; s++) {
+        double term = cs[s];
+        if (s == scales - 1) term *= l[s];
+        score *= std::pow(std::max(term, 0.0), kScaleWeights[s] / weightTotal);
+    }
+    return score;
+}
+
+} // namespace ssim
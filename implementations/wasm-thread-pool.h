@@ -0,0 +1,170 @@
+// Persistent worker pool for the image processing kernels
+//
+// std::thread maps onto pthreads under Emscripten (-pthread builds) and onto
+// native threads elsewhere. Builds without thread support run every job on
+// the calling thread, so kernels can use the pool unconditionally.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define IMAGE_THREADS_AVAILABLE 0
+#else
+#define IMAGE_THREADS_AVAILABLE 1
+#endif
+
+class ThreadPool {
+public:
+    // `threads` counts the calling thread, which always takes part in jobs
+    explicit ThreadPool(int threads) {
+#if IMAGE_THREADS_AVAILABLE
+        const int workers = std::max(threads, 1) - 1;
+        bands = std::vector<Band>(workers + 1);
+        for (int i = 0; i < workers; i++) {
+            workerThreads.emplace_back([this, i] { workerLoop(i + 1); });
+        }
+#endif
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : workerThreads) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {
+        return static_cast<int>(workerThreads.size()) + 1;
+    }
+
+    // Index of the calling thread within its pool: workers are 1..size()-1,
+    // every other thread (including the one calling parallelFor) is 0
+    static int currentParticipant() {
+        return participantIndex();
+    }
+
+    // Run fn(begin, end) over [0, count) in chunks of `grain` items and wait
+    // for completion. Chunks are dealt out as one contiguous band per thread;
+    // a thread that finishes its band steals chunks from the others. Calls
+    // made while the pool is busy (nested or concurrent) run inline.
+    // Returns the number of threads the job was offered to.
+    int parallelFor(int count, int grain, const std::function<void(int, int)>& fn) {
+        if (count <= 0) return 0;
+        grain = std::max(grain, 1);
+        const int chunks = (count + grain - 1) / grain;
+
+        std::unique_lock<std::mutex> dispatch(dispatchMutex, std::try_to_lock);
+        if (workerThreads.empty() || chunks == 1 || !dispatch.owns_lock()) {
+            fn(0, count);
+            return 1;
+        }
+
+        // Bands are reused across jobs; dispatchMutex keeps one job at a time
+        Job job;
+        job.fn = &fn;
+        job.count = count;
+        job.grain = grain;
+        job.bands = bands.data();
+        job.participants = size();
+        for (int p = 0; p < job.participants; p++) {
+            bands[p].next.store(chunks * p / job.participants, std::memory_order_relaxed);
+            bands[p].end = chunks * (p + 1) / job.participants;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentJob = &job;
+            activeWorkers = static_cast<int>(workerThreads.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        runJob(job, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return activeWorkers == 0; });
+        currentJob = nullptr;
+        return job.participants;
+    }
+
+private:
+    static int& participantIndex() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    struct Band {
+        std::atomic<int> next{0};
+        int end = 0;
+    };
+
+    struct Job {
+        const std::function<void(int, int)>* fn = nullptr;
+        int count = 0;
+        int grain = 1;
+        Band* bands = nullptr;
+        int participants = 0;
+    };
+
+    static void runJob(Job& job, int self) {
+        const int participants = job.participants;
+        for (int i = 0; i < participants; i++) {
+            // Own band first, then walk the other bands as a thief
+            Band& band = job.bands[(self + i) % participants];
+            for (;;) {
+                const int chunk = band.next.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= band.end) break;
+                const int begin = chunk * job.grain;
+                (*job.fn)(begin, std::min(begin + job.grain, job.count));
+            }
+        }
+    }
+
+    void workerLoop(int self) {
+        participantIndex() = self;
+        uint64_t seen = 0;
+        for (;;) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                job = currentJob;
+            }
+
+            runJob(*job, self);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--activeWorkers == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workerThreads;
+    std::vector<Band> bands;
+    std::mutex dispatchMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Job* currentJob = nullptr;
+    uint64_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+};